@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	arena.hpp
+
+	Defines Arena, a bump allocator for memory that all dies at the same
+	time, like everything one render needs. Allocating is a pointer bump,
+	deallocating does nothing, and reset() frees everything at once.
+
+	Arena is a std::pmr::memory_resource, so any pmr container can use it,
+	and so can Image, matrix, BVH and StaticScene through their constructors.
+
+	Whatever doesn't fit in the block spills to the upstream resource.
+	reset() then grows the block to cover it, so a workload that repeats
+	(like rendering the same scene every frame) stops touching the heap
+	after the first time through. Not thread-safe.
+*/
+
+#include <cstddef>
+#include <memory_resource>
+
+class Arena final : public std::pmr::memory_resource {
+public:
+	static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+	explicit Arena(const size_t& capacity = DEFAULT_CAPACITY, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+	~Arena();
+
+	//Everything handed out points into this Arena
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	//Frees everything at once. Only touches upstream if anything spilled since the last reset.
+	void reset();
+
+	inline size_t capacity() const { return blockSize; }
+	inline size_t spilled() const { return spilledBytes; } //Bytes taken from upstream since the last reset
+
+protected:
+	virtual void* do_allocate(size_t bytes, size_t alignment) override;
+	virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+	virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+	//Spilled chunks are freed on reset, so they're kept in a list threaded through themselves
+	struct chunk_header final {
+		chunk_header* next;
+		size_t size;
+	};
+
+	std::pmr::memory_resource* const upstream;
+
+	unsigned char* block;
+	size_t blockSize;
+
+	chunk_header* chunks;
+	size_t spilledBytes;
+
+	//Free space in the block or chunk currently being filled
+	unsigned char* cur;
+	unsigned char* end;
+
+	//Take bytes from [cur, end), or return nullptr if they don't fit
+	void* bump(const size_t& bytes, const size_t& alignment);
+};
@@ -48,9 +48,22 @@
 		attr_set(int) { _state = value%5; } //setter
 	};
 
+	attr pays for its flexibility: two std::functions and a heap-allocated
+	value, and every access is an indirect call. When the accessors are
+	known at compile time, use inline_attr or ref_attr instead. Their
+	accessors are template parameters, so every access inlines down to the
+	accessor's body, and with the defaults, to a plain field read or write:
+
+	static void wrap5(int& _state, const int& value) { _state = value%5; }
+	inline_attr<int, attr_default_get<int>, wrap5> state{ 0 };
+
+	ref_attr<Transform, mat4, &Transform::GetLocalToWorld, &Transform::SetLocalToWorld> localToWorld{ &_transform };
+
 */
 
 #include <functional>
+#include <cstddef>
+#include <type_traits>
 
 #ifdef ATTR_SHORTCUTS
 
@@ -175,4 +188,68 @@ public:
 	inline operator readonly_attr<T>() {
 		return readonly_attr<T>(*value_ptr, _getter);
 	}
-};
\ No newline at end of file
+};
+
+#pragma region Compile-time attributes
+
+//Default accessors for inline_attr
+template<typename T> inline T    attr_default_get(const T& _state) { return _state; }
+template<typename T> inline void attr_default_set(T& _state, const T& value) { _state = value; }
+
+//attr with the value stored inline and the accessors fixed at compile time.
+//Same size as T, and copyable, since there's nothing to point back at itself.
+template<typename T, T(*Get)(const T&) = attr_default_get<T>, void(*Set)(T&, const T&) = attr_default_set<T>>
+class inline_attr final {
+private:
+	T _state;
+
+public:
+	inline_attr() = default;
+
+	//Initial value is stored as is, without going through the setter, same as attr
+	inline inline_attr(const T& initial_value) : _state(initial_value) {}
+
+	inline_attr(const inline_attr&) = default;
+
+	//Assigning from another attribute is both a getter and setter call
+	inline inline_attr& operator=(const inline_attr& rhs) { return operator=((T)rhs); }
+
+	//Setter override
+	inline inline_attr& operator=(const T& rhs) {
+		Set(_state, rhs);
+		return *this;
+	}
+
+	//Getter override
+	inline operator T() const { return Get(_state); }
+};
+
+//attr that forwards to a getter and setter on another object, usually a member of the class
+//it's declared in. Only holds a pointer to that object, and both calls bind statically.
+//Get is called as (owner->*Get)(), and Set as (owner->*Set)(value). Leave Set null for a read-only attr.
+template<typename Owner, typename T, auto Get, auto Set = nullptr>
+class ref_attr final {
+private:
+	Owner* const owner;
+
+public:
+	inline explicit ref_attr(Owner* owner) : owner{ owner } {}
+
+	//A copy would still point at the original's owner
+	ref_attr(const ref_attr&) = delete;
+
+	//Assigning from another attribute is both a getter and setter call
+	inline ref_attr& operator=(const ref_attr& rhs) { return operator=((T)rhs); }
+
+	//Setter override
+	inline ref_attr& operator=(const T& rhs) {
+		static_assert(!std::is_same<decltype(Set), std::nullptr_t>::value, "This attribute is read-only");
+		(owner->*Set)(rhs);
+		return *this;
+	}
+
+	//Getter override
+	inline operator T() const { return (owner->*Get)(); }
+};
+
+#pragma endregion Compile-time attributes
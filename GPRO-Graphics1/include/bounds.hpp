@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	bounds.hpp
+
+	Defines aabb, an axis-aligned bounding box. Every Traceable can report
+	one, which is what lets acceleration structures like the BVH skip
+	whole groups of objects with a single cheap ray test.
+*/
+
+#include "vector.hpp"
+#include "ray.hpp"
+
+#include <cfloat>
+#include <algorithm>
+
+struct aabb final {
+public:
+	Vector3 min, max;
+
+	//Default is "inside out", so expanding it by anything yields that thing
+	inline aabb() : min{ FLT_MAX, FLT_MAX, FLT_MAX }, max{ -FLT_MAX, -FLT_MAX, -FLT_MAX } {}
+	inline aabb(const Vector3& _min, const Vector3& _max) : min{ _min }, max{ _max } {}
+
+	inline bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+	inline Vector3 GetCenter() const { return (min + max) * 0.5f; }
+	inline Vector3 GetSize  () const { return max - min; }
+
+	inline float GetSurfaceArea() const {
+		if (IsEmpty()) return 0;
+		Vector3 s = GetSize();
+		return 2 * (s.x*s.y + s.y*s.z + s.z*s.x);
+	}
+
+	//Index of the longest axis: 0 = x, 1 = y, 2 = z
+	inline int GetLongestAxis() const {
+		Vector3 s = GetSize();
+		return (s.x >= s.y && s.x >= s.z) ? 0 : (s.y >= s.z ? 1 : 2);
+	}
+
+	inline void Expand(const Vector3& point) {
+		min = Vector3(std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z));
+		max = Vector3(std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z));
+	}
+
+	inline void Expand(const aabb& other) {
+		if (other.IsEmpty()) return;
+		Expand(other.min);
+		Expand(other.max);
+	}
+
+	//Slab test. invDir is 1/ray.direction, precomputed since it's shared by every box a ray visits.
+	//Returns whether the ray overlaps the box anywhere within [t_min, t_max].
+	inline bool Intersect(const Ray& ray, const Vector3& invDir, float t_min, float t_max) const {
+		float t0 = (min.x - ray.origin.x) * invDir.x;
+		float t1 = (max.x - ray.origin.x) * invDir.x;
+		t_min = std::max(t_min, std::min(t0, t1));
+		t_max = std::min(t_max, std::max(t0, t1));
+
+		t0 = (min.y - ray.origin.y) * invDir.y;
+		t1 = (max.y - ray.origin.y) * invDir.y;
+		t_min = std::max(t_min, std::min(t0, t1));
+		t_max = std::min(t_max, std::max(t0, t1));
+
+		t0 = (min.z - ray.origin.z) * invDir.z;
+		t1 = (max.z - ray.origin.z) * invDir.z;
+		t_min = std::max(t_min, std::min(t0, t1));
+		t_max = std::min(t_max, std::max(t0, t1));
+
+		return t_min <= t_max;
+	}
+
+	static inline Vector3 InverseDirection(const Ray& ray) {
+		return Vector3(1 / ray.direction.x, 1 / ray.direction.y, 1 / ray.direction.z);
+	}
+};
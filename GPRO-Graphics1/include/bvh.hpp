@@ -0,0 +1,164 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	bvh.hpp
+
+	Defines the bounding volume hierarchy. bvh_tree is the bare structure:
+	it only knows about boxes and primitive indices, so anything that can
+	produce a list of aabbs can be accelerated by it. BVH wraps a bvh_tree
+	around a list of Traceables, and is itself Traceable, so it can be
+	handed to Camera::render in place of a flat object list.
+*/
+
+#include "raytrace.hpp"
+#include "bounds.hpp"
+
+#include <vector>
+#include <memory_resource>
+
+struct bvh_node final {
+public:
+	aabb box;
+	int first; //Leaf: first slot in bvh_tree::indices. Interior: index of left child (right child is first+1)
+	int count; //Leaf: number of primitives. Interior: 0
+
+	inline bool IsLeaf() const { return count > 0; }
+};
+
+class bvh_tree final {
+public:
+	static constexpr int DEFAULT_LEAF_SIZE = 4;
+	static constexpr int MAX_DEPTH = 64; //Traversal stack size. Median splits never get close.
+
+	std::pmr::vector<bvh_node> nodes;  //Root is nodes[0]
+	std::pmr::vector<int>      indices; //Primitive indices, reordered so every leaf owns a contiguous run
+
+	//Nodes, indices and build scratch all come from mem
+	explicit bvh_tree(std::pmr::memory_resource* mem = std::pmr::get_default_resource()) : nodes(mem), indices(mem) {}
+
+	inline std::pmr::memory_resource* GetResource() const { return nodes.get_allocator().resource(); }
+
+	//Build over the given primitive boxes, splitting at the median of the longest axis
+	void build(const std::pmr::vector<aabb>& primitiveBounds, int maxLeafSize = DEFAULT_LEAF_SIZE);
+
+	//Adopts nodes from a tree built earlier, for example one saved to a file, in place of building.
+	//indices becomes the identity, so the primitives must already be in leaf order. Throws
+	//std::invalid_argument, and changes nothing, unless nodes is a well-formed tree over primitiveCount primitives.
+	void assign(std::pmr::vector<bvh_node>&& nodes, const int& primitiveCount);
+
+	inline bool IsEmpty() const { return nodes.empty(); }
+	inline aabb GetBounds() const { return IsEmpty() ? aabb() : nodes[0].box; }
+
+	//Calls visit(leaf) for every leaf the ray enters within [t_min, t_max]. t_max is
+	//re-read after every visit, so closest-hit queries can shrink it as they go.
+	//If visit returns true, traversal stops immediately (used by any-hit queries).
+	template<typename F>
+	void traverse(const Ray& ray, float t_min, const float& t_max, F&& visit) const {
+		if (IsEmpty()) return;
+		const Vector3 invDir = aabb::InverseDirection(ray);
+
+		int stack[MAX_DEPTH];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const bvh_node& node = nodes[stack[--top]];
+			if (!node.box.Intersect(ray, invDir, t_min, t_max)) continue;
+
+			if (node.IsLeaf()) {
+				if (visit(node)) return;
+			}
+			else {
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+			}
+		}
+	}
+
+	//Packet form of traverse. Calls visit(leaf, lanes) for every leaf that at least one
+	//of the given lanes enters; lanes holds just those. t_max is per lane, and is
+	//re-read the same way. Each lane visits leaves in the same order traverse() would.
+	template<typename F>
+	void traverse(const ray_packet& rays, float t_min, const float* t_max, int lanes, F&& visit) const {
+		if (IsEmpty() || lanes == 0) return;
+
+		const pfloat ox = pfloat::Load(rays.ox), oy = pfloat::Load(rays.oy), oz = pfloat::Load(rays.oz);
+		const pfloat one = pfloat(1.0f);
+		const pfloat ix = one / pfloat::Load(rays.dx), iy = one / pfloat::Load(rays.dy), iz = one / pfloat::Load(rays.dz);
+		const pfloat lo = pfloat(t_min);
+
+		struct entry { int node, lanes; };
+		entry stack[MAX_DEPTH];
+		int top = 0;
+		stack[top++] = { 0, lanes };
+		while (top > 0) {
+			const entry cur = stack[--top];
+			const bvh_node& node = nodes[cur.node];
+
+			//aabb::Intersect per lane. Min/Max argument order reproduces std::min/max
+			//exactly, NaN included, so no lane culls a box its scalar ray wouldn't.
+			pfloat t_enter = lo, t_exit = pfloat::Load(t_max);
+			pfloat t0 = (pfloat(node.box.min.x) - ox) * ix, t1 = (pfloat(node.box.max.x) - ox) * ix;
+			t_enter = pfloat::Max(pfloat::Min(t1, t0), t_enter); t_exit = pfloat::Min(pfloat::Max(t1, t0), t_exit);
+			t0 = (pfloat(node.box.min.y) - oy) * iy; t1 = (pfloat(node.box.max.y) - oy) * iy;
+			t_enter = pfloat::Max(pfloat::Min(t1, t0), t_enter); t_exit = pfloat::Min(pfloat::Max(t1, t0), t_exit);
+			t0 = (pfloat(node.box.min.z) - oz) * iz; t1 = (pfloat(node.box.max.z) - oz) * iz;
+			t_enter = pfloat::Max(pfloat::Min(t1, t0), t_enter); t_exit = pfloat::Min(pfloat::Max(t1, t0), t_exit);
+
+			const int active = (t_enter <= t_exit).Bits() & cur.lanes;
+			if (active == 0) continue;
+
+			if (node.IsLeaf()) {
+				visit(node, active);
+			}
+			else {
+				stack[top++] = { node.first + 1, active };
+				stack[top++] = { node.first    , active };
+			}
+		}
+	}
+
+private:
+	void buildNode(int nodeIndex, int first, int count, const std::pmr::vector<aabb>& primitiveBounds, const std::pmr::vector<float>& centroids, int maxLeafSize, int depth);
+};
+
+//Does not own its objects. Call rebuild() after moving them.
+class BVH final : public Traceable {
+public:
+	//Everything the BVH allocates comes from mem, which can be an Arena for one-render scenes
+	BVH(const std::vector<Traceable*>& objects, int maxLeafSize = bvh_tree::DEFAULT_LEAF_SIZE, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+
+	void rebuild();
+
+	inline const bvh_tree& GetTree() const { return tree; }
+
+	using Traceable::trace;
+	virtual void trace(const Ray& ray, hit_buffer& out) override;
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) override;
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max) override;
+	virtual void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes) override;
+	virtual aabb bounds() const override;
+
+	//A BVH has no surface of its own. Use trace_hit::normal instead.
+	virtual Vector3 normal_at(const Vector3& pos) override;
+
+private:
+	std::pmr::vector<Traceable*> objects;
+	bvh_tree tree;
+	int maxLeafSize;
+};
@@ -4,11 +4,47 @@
 #include "raytrace.hpp"
 #include "color.hpp"
 #include "image.hpp"
+#include "scanlinewriter.hpp"
+#include "arena.hpp"
 
 #define ATTR_SHORTCUTS
 #include "attr.inl"
 
 #include <vector>
+#include <memory>
+
+class ThreadPool;
+
+//Ray directions for every pixel of a width x height frame at one fov. Pixel (x, y)
+//looks along (tanX[x], tanY[y], 1), exactly what Camera::prepareTracer computes, so
+//building a table costs width+height tanf calls and every ray after that is two loads.
+struct ray_table final {
+public:
+	const int width, height;
+	const float fov;
+	std::vector<float> tanX, tanY;
+
+	ray_table(const int& width, const int& height, const float& fov_radians);
+
+	inline bool Matches(const int& w, const int& h, const float& f) const { return w == width && h == height && f == fov; }
+
+	inline Ray GetRay(const int& px_x, const int& px_y) const { return Ray(Vector3::zero(), Vector3(tanX[px_x], tanY[px_y], 1)); }
+
+	//Batch versions. Directions go into contiguous arrays, origins are all zero.
+	//Pixels [x0, x1) of row y, into dx[0] through dx[x1-x0-1]
+	void GetRow(const int& px_y, const int& x0, const int& x1, float* dx, float* dy, float* dz) const;
+	//Every pixel of [x0, x1) x [y0, y1), row by row
+	void GetTile(const int& x0, const int& y0, const int& x1, const int& y1, float* dx, float* dy, float* dz) const;
+	//ray_packet::WIDTH pixels of row y starting at x. Lanes at or past x1 repeat pixel x1-1.
+	void GetPacket(const int& px_y, const int& x, const int& x1, ray_packet& out) const;
+};
+
+//What render(std::vector) builds over its objects
+enum class scene_accelerator {
+	AUTO, //Whichever uniform_grid::Suits says, per scene
+	BVH,  //Fewer object tests per ray. Best when objects vary a lot in size or are clustered.
+	GRID  //Faster to build, in parallel. Best for lots of similar-sized objects that move every frame.
+};
 
 class Camera final {
 public:
@@ -16,12 +52,89 @@ public:
 
 	float fov;
 
+	//Number of threads used by render(). 1 renders serially on the calling
+	//thread, 0 uses every hardware thread. Output is identical either way.
+	//The threads are started by the first render that needs them, and kept
+	//for every render after, until threadCount changes.
+	unsigned int threadCount;
+
+	//Width and height, in pixels, of the tiles handed out to render threads
+	int tileSize;
+
+	//Trace ray_packet::WIDTH neighbouring pixels at a time. Output is identical either way.
+	bool usePackets;
+
+	//Acceleration structure render(std::vector) builds every call
+	scene_accelerator accelerator;
+
+	//Scratch memory for each render: the BVH render(std::vector) builds, and row buffers.
+	//Reset at the start of every render, so reusing one Arena across frames means steady-state
+	//renders never touch the heap. If null, each render makes its own. Don't share one between
+	//cameras that render at the same time.
+	Arena* arena;
+
 	//Uses *radians, not degrees*
 	Camera(Image& viewport, const float& fov_radians);
+	//No viewport, for cameras that only stream (see render(..., ScanlineWriter&))
+	explicit Camera(const float& fov_radians);
+	~Camera();
 
-	inline Ray prepareTracer(const int& px_x, const int& px_y) const;
+	//Cameras own their render threads, so they can't be copied
+	Camera(const Camera&) = delete;
+	Camera& operator=(const Camera&) = delete;
+
+	//Ray through a pixel of the viewport, or of any other width x height frame.
+	//Computed from scratch every call. For many rays, getRayTable is far cheaper.
+	Ray prepareTracer(const int& px_x, const int& px_y) const;
+	Ray prepareTracer(const int& px_x, const int& px_y, const int& width, const int& height) const;
+
+	//Every ray of a width x height frame at the current fov. Cached, and only rebuilt
+	//when the resolution or fov changes. Safe to call from any thread.
+	std::shared_ptr<const ray_table> getRayTable(const int& width, const int& height) const;
 
 	//Render a vector of Traceable elements. THESE MUST BE ON THE HEAP
 	//otherwise polymorphism will fail to take effect.
-	void render(std::vector<Traceable*>) const;
-};
\ No newline at end of file
+	//Builds a BVH or uniform grid over them first (see accelerator), so each ray only visits nearby objects.
+	//To store objects by value instead, see StaticScene.
+	void render(const std::vector<Traceable*>& objects) const;
+
+	//Render a single Traceable, usually an acceleration structure like BVH
+	void render(Traceable& scene) const;
+
+	//Streaming versions. Instead of filling viewport, each row is handed to out as soon
+	//as it's traced, so only out's window of rows is ever in memory. Resolution comes
+	//from out. Returns once the whole image has been written.
+	void render(const std::vector<Traceable*>& objects, ScanlineWriter& out) const;
+	void render(Traceable& scene, ScanlineWriter& out) const;
+
+private:
+	//Last table getRayTable built. Only touched through std::atomic_load/atomic_store.
+	mutable std::shared_ptr<const ray_table> rayCache;
+
+	//Render threads, kept between renders. Only touched through getPool.
+	mutable std::unique_ptr<ThreadPool> pool;
+
+	//pool, started (or restarted) if it doesn't have threadCount threads. Don't render
+	//with one Camera from several threads at once.
+	ThreadPool& getPool() const;
+
+	//Trace a single pixel. Only depends on its inputs, so it's safe to call from any thread.
+	Color tracePixel(const ray_table& rays, const int& px_x, const int& px_y, Traceable& scene) const;
+
+	//Trace pixels [x0, x1) of row y, into out[0] through out[x1-x0-1]
+	void traceRow(const ray_table& rays, const int& px_y, const int& x0, const int& x1, Traceable& scene, Color* out) const;
+
+	//Background for rays that hit nothing
+	Color skyColor(const int& px_y, const int& height) const;
+
+	//arena, reset, or a fresh Arena kept alive by fallback if there isn't one
+	Arena& beginFrame(std::unique_ptr<Arena>& fallback) const;
+
+	//BVH or UniformGrid over objects, per accelerator. Constructed in frame, so it must be
+	//destroyed with ~Traceable, never deleted.
+	Traceable* buildScene(const std::vector<Traceable*>& objects, Arena& frame) const;
+
+	void renderImage(Traceable& scene, Arena& frame) const;
+	void renderSerial(const ray_table& rays, Traceable& scene, Arena& frame) const;
+	void renderParallel(const ray_table& rays, Traceable& scene, Arena& frame) const;
+};
@@ -27,11 +27,14 @@
 
 #include "rawdata.hpp"
 
-//Really just a fancier interface sitting on top of a float3. Provides references
+//Really just a fancier interface sitting on top of a float3. Provides names
 //for RGB, and also adds factory initializers and HSV utility methods.
 struct Color final : public float3 {
 public:
-	float &r, &g, &b;
+	//Named views of float3's storage. Together with _scale, a Color is 16 bytes.
+	using float3::r;
+	using float3::g;
+	using float3::b;
 
 	//RGB factory initializer
 	static Color FromRGB(const float& _r, const float& _g, const float& _b, const float& scale = 1);
@@ -42,19 +45,19 @@ public:
 	float GetSaturation() const;
 	float GetValue() const;
 
-	float GetScale() const;
+	inline float GetScale() const { return _scale; }
 	inline void SetScale(float newScale); //Only changes scale.
 	Color RemapScale(float newScale); //Changes scale, and remaps color values to match.
 
-	Color& operator=(const float3& rhs);
-	Color& operator=(const Color& rhs);
+	Color& operator=(const float3& rhs); //Keeps scale
+	Color& operator=(const Color& rhs) = default;
 
 	//Cast conversion. Allows float3's operators to still work, including the mildly dangerous *=
 	//Also allows unsafe, unchecked conversions between Color and Vector3.
 	Color(const float3& base);
 
-	//Copy constructor, because C++ implicitly deletes it otherwise.
-	inline Color(const Color& cpy) : Color((const float3&)cpy) {}
+	//Trivial, so Color can be memcpy'd
+	Color(const Color& cpy) = default;
 
 	//Default constructor: Black, color scale = 1.0
 	Color();
@@ -62,4 +65,7 @@ private:
 	Color(const float& _r, const float& _g, const float& _b, const float& _scale = 1);
 
 	float _scale; //Usually 1.0 for runtime colors, and 255.0 for serialized colors
-};
\ No newline at end of file
+};
+
+static_assert(sizeof(Color) == 4*sizeof(float), "Color must be tightly packed");
+static_assert(std::is_trivially_copyable<Color>::value, "Color must be trivially copyable");
\ No newline at end of file
@@ -0,0 +1,189 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	grid.hpp
+
+	Defines the uniform grid, the BVH's counterpart for scenes where
+	everything moves every frame. uniform_grid is the bare structure: it
+	chops the scene's box into equal cells and lists which primitives
+	overlap each one. Building it is two linear passes with no global sort,
+	and they split across threads, so rebuilding from scratch every frame
+	is cheap. Rays walk it cell by cell, nearest first (3D-DDA).
+
+	UniformGrid wraps a uniform_grid around a list of Traceables, the same
+	way BVH wraps a bvh_tree. Grids suit lots of similar-sized objects
+	spread fairly evenly; a few huge objects, or a few dense clusters in a
+	big empty space, are BVH territory. uniform_grid::Suits tells them apart.
+*/
+
+#include "raytrace.hpp"
+#include "bounds.hpp"
+
+#include <cfloat>
+#include <vector>
+#include <memory_resource>
+
+class ThreadPool;
+
+class uniform_grid final {
+public:
+	static constexpr float DEFAULT_DENSITY = 2;  //Cells per primitive
+	static constexpr int MAX_RESOLUTION = 256;   //Cells along any one axis
+
+	aabb box;
+	int res[3];        //Cells along x, y and z
+	float cellSize[3]; //Size of one cell along x, y and z
+	float invCellSize[3];
+
+	//Cell (x, y, z) is index x + res[0]*(y + res[1]*z). Its primitives are
+	//indices[cellStart[cell]] up to (but not including) indices[cellStart[cell+1]],
+	//in ascending order. Primitives overlapping several cells are listed in each.
+	std::pmr::vector<int> cellStart;
+	std::pmr::vector<int> indices;
+
+	//Cells, indices and build scratch all come from mem
+	explicit uniform_grid(std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+
+	inline std::pmr::memory_resource* GetResource() const { return indices.get_allocator().resource(); }
+
+	//Build over the given primitive boxes. Empty boxes are left out. If pool isn't null, the
+	//work is split across it. The result is the same either way, down to the order of indices.
+	void build(const std::pmr::vector<aabb>& primitiveBounds, float density = DEFAULT_DENSITY, ThreadPool* pool = nullptr);
+
+	inline bool IsEmpty() const { return indices.empty(); }
+	inline aabb GetBounds() const { return IsEmpty() ? aabb() : box; }
+	inline int GetCellCount() const { return res[0] * res[1] * res[2]; }
+
+	//Whether a grid is likely to trace the given primitives faster than a bvh_tree: there
+	//are enough of them, they're close enough in size, and they fill enough of the cells.
+	//Linear time, and cheap next to either build.
+	static bool Suits(const std::pmr::vector<aabb>& primitiveBounds, float density = DEFAULT_DENSITY);
+
+	//Calls visit(first, count) for every non-empty cell the ray passes through within
+	//[t_min, t_max], nearest first, where first and count locate the cell's run of indices.
+	//t_max is re-read after every visit, so closest-hit queries can shrink it as they go:
+	//once a hit is closer than the next cell, nothing further along can beat it.
+	//If visit returns true, traversal stops immediately (used by any-hit queries).
+	template<typename F>
+	void traverse(const Ray& ray, float t_min, const float& t_max, F&& visit) const {
+		if (IsEmpty()) return;
+
+		const float o[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+		const float d[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+		const float lo[3] = { box.min.x, box.min.y, box.min.z };
+		const float hi[3] = { box.max.x, box.max.y, box.max.z };
+
+		//Clip to the grid, same slab test as aabb::Intersect, keeping the entry distance
+		float t_enter = t_min, t_exit = t_max;
+		float inv[3];
+		for (int a = 0; a < 3; a++) {
+			inv[a] = 1 / d[a];
+			const float t0 = (lo[a] - o[a]) * inv[a];
+			const float t1 = (hi[a] - o[a]) * inv[a];
+			t_enter = std::max(t_enter, std::min(t0, t1));
+			t_exit  = std::min(t_exit , std::max(t0, t1));
+		}
+		if (!(t_enter <= t_exit)) return;
+
+		//Start in whichever cell the entry point lands in, then step one cell boundary at a time
+		int cell[3], step[3];
+		float t_next[3], t_delta[3];
+		for (int a = 0; a < 3; a++) {
+			const float p = o[a] + d[a] * t_enter;
+			cell[a] = std::min(std::max((int)((p - lo[a]) * invCellSize[a]), 0), res[a] - 1);
+
+			if (d[a] > 0) {
+				step[a] = 1;
+				t_next[a] = (lo[a] + (cell[a] + 1) * cellSize[a] - o[a]) * inv[a];
+				t_delta[a] = cellSize[a] * inv[a];
+			}
+			else if (d[a] < 0) {
+				step[a] = -1;
+				t_next[a] = (lo[a] + cell[a] * cellSize[a] - o[a]) * inv[a];
+				t_delta[a] = -cellSize[a] * inv[a];
+			}
+			else {
+				//Parallel to this axis, so never crosses into another cell along it
+				step[a] = 0;
+				t_next[a] = FLT_MAX;
+				t_delta[a] = FLT_MAX;
+			}
+		}
+
+		while (true) {
+			const int index = cell[0] + res[0] * (cell[1] + res[1] * cell[2]);
+			const int first = cellStart[index], count = cellStart[index + 1] - first;
+			if (count > 0 && visit(first, count)) return;
+
+			//Next boundary crossed is the nearest one
+			const int a = (t_next[0] < t_next[1]) ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+			if (t_next[a] > t_max || step[a] == 0) return;
+
+			cell[a] += step[a];
+			if (cell[a] < 0 || cell[a] >= res[a]) return;
+			t_next[a] += t_delta[a];
+		}
+	}
+
+private:
+	//Cells overlapped by a box, inclusive, padded slightly so rounding in traverse() can't
+	//place a point on a primitive in a cell that doesn't list it
+	void getCellRange(const aabb& b, int first[3], int last[3]) const;
+
+	//Picks box, res and cellSize for count primitives within bounds
+	void setResolution(const aabb& bounds, int count, float density);
+};
+
+//Does not own its objects. Call rebuild() after moving them; it's meant to be called every frame.
+class UniformGrid final : public Traceable {
+public:
+	//Everything the grid allocates comes from mem, which can be an Arena for one-render scenes.
+	//Rebuilds use threadCount threads (0 = every hardware thread), once there are enough objects to be worth it.
+	UniformGrid(const std::vector<Traceable*>& objects, float density = uniform_grid::DEFAULT_DENSITY, unsigned int threadCount = 0, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+	//Built on an existing pool instead of starting threads. rebuild() uses as many threads as pool has.
+	UniformGrid(const std::vector<Traceable*>& objects, ThreadPool& pool, float density = uniform_grid::DEFAULT_DENSITY, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+
+	//Below this many objects, rebuilds stay on the calling thread. Starting threads costs more.
+	static constexpr int PARALLEL_THRESHOLD = 4096;
+
+	void rebuild();
+	//Rebuild on an existing pool, to avoid starting threads every frame
+	void rebuild(ThreadPool& pool);
+
+	inline const uniform_grid& GetGrid() const { return grid; }
+
+	//Rays in a packet quickly end up in different cells, so trace_packet is the
+	//default: each lane walks the grid on its own through trace_closest.
+	using Traceable::trace;
+	virtual void trace(const Ray& ray, hit_buffer& out) override;
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) override;
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max) override;
+	virtual aabb bounds() const override;
+
+	//A grid has no surface of its own. Use trace_hit::normal instead.
+	virtual Vector3 normal_at(const Vector3& pos) override;
+
+private:
+	std::pmr::vector<Traceable*> objects;
+	uniform_grid grid;
+	float density;
+	unsigned int threadCount;
+
+	void rebuild(ThreadPool* pool);
+};
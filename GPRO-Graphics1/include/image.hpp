@@ -6,32 +6,115 @@
 #include "attr.inl"
 
 #include <ostream>
+#include <vector>
+#include <stdexcept>
+#include <memory_resource>
+
+//Netpbm encodings write_to can produce
+enum class image_format {
+	P3, //ASCII. Any color space, but slow and roughly 4x larger.
+	P6  //Binary. 1 byte per channel if color_space < 256, otherwise 2 (big-endian). Color space is capped at 65535.
+};
+
+//How Image stores each pixel. All are tightly packed.
+enum class pixel_format {
+	RGB8,    //3 bytes. Stores exactly what write_to will output, so color_space must be 1 to 255. Clamps.
+	RGBA16F, //8 bytes. Half floats, normalized to scale 1. Alpha is always 1.
+	RGB32F   //12 bytes. Floats, normalized to scale 1.
+};
+
+//Where Image puts each pixel in memory. Doesn't change anything visible
+//through the API, write_to always outputs rows in order.
+enum class pixel_layout {
+	ROW_MAJOR, //x + y*width. Fastest for whole rows, and the only layout write_to can dump as-is.
+	TILED,     //8x8 tiles in row-major order, each one row-major inside. A tile is 1 to 12 cache lines.
+	MORTON     //Same tiles, but Z-order inside, so any 2x2, 4x4 or 8x8 aligned block is contiguous.
+};
 
 class Image final
 {
 private:
 	//1D array dodges "pointer-to-pointer" badness
-	Color* pixels;
+	std::pmr::vector<unsigned char> data;
+
+	//Tiles per row, for the tiled layouts. Partial tiles at the edges are padded out.
+	int tilesX;
 
-	inline int _ind(int x, int y) const;
-	//Used only by binary output mode
-	//static constexpr bool is_illegal(const char& c) { return c == 11; }
+	//Pixel index into data, not byte index
+	inline int _ind(int x, int y) const {
+#ifdef _DEBUG
+		if (x < 0 || x >= width || y < 0 || y >= height) throw std::invalid_argument("Index out of bounds!");
+#endif
+		switch (layout) {
+		case pixel_layout::TILED : return (((y >> 3) * tilesX + (x >> 3)) << 6) | ((y & 7) << 3) | (x & 7);
+		case pixel_layout::MORTON: return (((y >> 3) * tilesX + (x >> 3)) << 6) | _spread(x & 7) | (_spread(y & 7) << 1);
+		default: return x+y*width;
+		}
+	}
+
+	//Spaces out the low 3 bits, abc -> a0b0c
+	static inline int _spread(int v) { return (v & 1) | ((v & 2) << 1) | ((v & 4) << 2); }
+
+	//How many pixels from (x, y) rightward are next to each other in data
+	inline int _runLength(int x) const {
+		const int run = layout == pixel_layout::TILED ? TILE_SIZE - (x & 7) : 2 - (x & 1);
+		return run < width - x ? run : width - x;
+	}
+
+	//Calls run(first, offset, count) for each stretch of count pixels that's contiguous in data,
+	//starting at pixel index first and covering pixels [offset, offset+count) of a get/set_pixels call
+	template<typename F> void _forEachRun(int x, int y, const int& count, F&& run) const;
+
+	//Convert count pixels that are contiguous in data, starting at pixel index first
+	void _load (const int& first, Color* out, const int& count) const;
+	void _store(const int& first, const Color* in, const int& count);
 
 public:
 	const int width;
 	const int height;
 	const float color_space;
+	const pixel_format format;
+	const pixel_layout layout;
 	static constexpr int DEFAULT_COLOR_SPACE = 255;
+	static constexpr int TILE_SIZE = 8; //Width and height of a tile, for the tiled layouts
 
+	//Picks RGB8 if color_space fits in a byte, otherwise RGB32F
 	Image(const int& w, const int& h);
 	Image(const int& w, const int& h, const float& c);
-	
-	~Image();
+	//Pixels are allocated from mem, which can be an Arena for per-frame images
+	Image(const int& w, const int& h, const float& c, const pixel_format& format, const pixel_layout& layout = pixel_layout::ROW_MAJOR, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
 
-	inline Color& pixel_at(int x, int y) const {
-		return pixels[_ind(x, y)];
-	}
+	static int BytesPerPixel(const pixel_format& format);
+	inline size_t GetByteSize() const { return data.size(); } //Includes tile padding
 
-	void write_to(std::ostream& out);
-};
+	//Conversion happens on every get/set, so prefer the bulk versions for whole rows
+	Color get_pixel(const int& x, const int& y) const;
+	void  set_pixel(const int& x, const int& y, const Color& value);
+	//count pixels from (x, y) onward, wrapping to following rows. Any layout, but ROW_MAJOR converts in one go.
+	void get_pixels(const int& x, const int& y, Color* out, const int& count) const;
+	void set_pixels(const int& x, const int& y, const Color* in, const int& count);
 
+	//Lets pixel_at(x, y) = color and Color c = pixel_at(x, y) keep working
+	class pixel_ref final {
+	private:
+		Image& image;
+		const int x, y;
+	public:
+		inline pixel_ref(Image& image, const int& x, const int& y) : image{ image }, x{ x }, y{ y } {}
+		inline operator Color() const { return image.get_pixel(x, y); }
+		inline pixel_ref& operator=(const Color& value) { image.set_pixel(x, y, value); return *this; }
+	};
+
+	inline pixel_ref pixel_at(int x, int y)       { return pixel_ref(*this, x, y); }
+	inline Color     pixel_at(int x, int y) const { return get_pixel(x, y); }
+
+	//Binary formats need out opened with std::ios::binary. Throws std::invalid_argument if out
+	//isn't open, and std::runtime_error if it fails partway.
+	void write_to(std::ostream& out, const image_format& format = image_format::P3) const;
+
+	//The two halves of write_to, for writers that don't hold the whole image (see ScanlineWriter).
+	//Pixels can be written in any number of pieces, as long as they're in row order.
+	//scratch is reused between calls to avoid reallocating.
+	static void write_header(std::ostream& out, const int& width, const int& height, const float& color_space, const image_format& format);
+	static void write_pixels(std::ostream& out, const Color* pixels, const int& count, const float& color_space, const image_format& format, std::vector<unsigned char>& scratch);
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	instance.hpp
+
+	Defines InstanceSet, for scenes full of copies of the same thing. The
+	shared geometry (any Traceable, in its own local space) is stored once,
+	and each copy is just an instance: a 3x4 transform, a geometry index
+	and a material index, 56 bytes in all. A Sphere carries its own
+	Transform, and is 256 bytes before counting the pointer to it.
+
+	Instances are found through a bvh_tree, and each ray is moved into an
+	instance's space once when it gets there, then handed to the geometry
+	as is. Hits come back out in world space.
+
+		InstanceSet scene;
+		Sphere unit(Vector3::zero(), 1);
+		const int ball = scene.addGeometry(&unit);
+		for (...) scene.add(ball, mat4::Translate(position));
+		scene.rebuild();
+		camera.render(scene);
+*/
+
+#include "raytrace.hpp"
+#include "bvh.hpp"
+#include "mat4.hpp"
+
+#include <vector>
+#include <memory_resource>
+
+//Affine transform, stored without its bottom row (always 0 0 0 1). Same layout as the
+//first 12 floats of mat4, and transforms points and vectors the same way.
+struct affine final {
+public:
+	float m[12];
+
+	//Uninitialized, like float[12]. Use a factory or convert a mat4.
+	affine() = default;
+	explicit affine(const mat4& mat);
+
+	static affine Identity();
+	mat4 ToMat4() const;
+
+	inline Vector3 TransformPoint(const Vector3& point) const {
+		return Vector3(
+			m[0]*point.x + m[1]*point.y + m[ 2]*point.z + m[ 3],
+			m[4]*point.x + m[5]*point.y + m[ 6]*point.z + m[ 7],
+			m[8]*point.x + m[9]*point.y + m[10]*point.z + m[11]
+		);
+	}
+
+	inline Vector3 TransformVector(const Vector3& vector) const {
+		return Vector3(
+			m[0]*vector.x + m[1]*vector.y + m[ 2]*vector.z,
+			m[4]*vector.x + m[5]*vector.y + m[ 6]*vector.z,
+			m[8]*vector.x + m[9]*vector.y + m[10]*vector.z
+		);
+	}
+
+	//Transposed 3x3 times vector. Applied to a world-to-local transform, takes normals from local to world (unnormalized).
+	inline Vector3 TransposeTransformVector(const Vector3& vector) const {
+		return Vector3(
+			m[0]*vector.x + m[4]*vector.y + m[ 8]*vector.z,
+			m[1]*vector.x + m[5]*vector.y + m[ 9]*vector.z,
+			m[2]*vector.x + m[6]*vector.y + m[10]*vector.z
+		);
+	}
+};
+
+struct instance final {
+public:
+	affine worldToLocal; //Every ray goes through this once per visit, so it's stored rather than localToWorld
+	int geometry;        //Index into InstanceSet's geometries
+	int material;        //Index into InstanceSet's materials, or InstanceSet::NO_MATERIAL
+};
+
+//Does not own its geometry. Call rebuild() after adding or moving instances, or changing geometry.
+class InstanceSet final : public Traceable {
+public:
+	//Keeps whatever color the geometry reports
+	static constexpr int NO_MATERIAL = -1;
+
+	//Instances, the tree over them, and everything else come from mem
+	explicit InstanceSet(int maxLeafSize = bvh_tree::DEFAULT_LEAF_SIZE, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+
+	//Shared geometry, in its own local space. Anything Traceable, including another InstanceSet.
+	int addGeometry(Traceable* geometry);
+	//Flat color that replaces the geometry's own on every instance that uses it
+	int addMaterial(const Color& color);
+
+	//Returns the new instance's index
+	int add(const int& geometry, const mat4& localToWorld, const int& material = NO_MATERIAL);
+	void setTransform(const int& index, const mat4& localToWorld);
+
+	inline size_t size() const { return instances.size(); }
+	inline const instance& get(const int& index) const { return instances[index]; }
+	inline const bvh_tree& GetTree() const { return tree; }
+
+	void rebuild();
+
+	using Traceable::trace;
+	virtual void trace(const Ray& ray, hit_buffer& out) override;
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) override;
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max) override;
+	virtual void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes) override;
+	virtual aabb bounds() const override;
+
+	//A set has no surface of its own. Use trace_hit::normal instead.
+	virtual Vector3 normal_at(const Vector3& pos) override;
+
+private:
+	std::pmr::vector<Traceable*> geometries;
+	std::pmr::vector<Color> materials;
+	std::pmr::vector<instance> instances;
+	bvh_tree tree;
+	int maxLeafSize;
+
+	inline Ray toLocal(const instance& inst, const Ray& ray) const {
+		return Ray(inst.worldToLocal.TransformPoint(ray.origin), inst.worldToLocal.TransformVector(ray.direction));
+	}
+
+	//Hit from the geometry, for a ray in inst's space, back into world space. t is the
+	//same in both (the ray direction isn't renormalized), so only the rest needs moving.
+	void toWorld(const instance& inst, const Ray& ray, trace_hit& hit) const;
+};
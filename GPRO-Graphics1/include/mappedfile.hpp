@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	mappedfile.hpp
+
+	Defines mapped_file, a read-only memory mapping of a whole file. The
+	OS pages the file in as it's touched, so "loading" costs nothing up
+	front, and nothing is copied: binary formats can be used straight out
+	of data(). Unmapped when destroyed.
+*/
+
+#include <cstddef>
+#include <string>
+
+class mapped_file final {
+public:
+	//Throws std::runtime_error if the file can't be opened or mapped
+	explicit mapped_file(const std::string& path);
+	~mapped_file();
+
+	//Owns the mapping
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	//Page-aligned. Null for an empty file.
+	inline const unsigned char* data() const { return view; }
+	inline size_t size() const { return length; }
+
+private:
+	const unsigned char* view;
+	size_t length;
+
+#ifdef _WIN32
+	void* file;    //HANDLEs, kept opaque so windows.h stays out of the header
+	void* mapping;
+#endif
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	mat4.hpp
+
+	Defines mat4, a fixed-size 4x4 transform. Where matrix is general
+	and heap-backed, mat4 lives entirely on the stack and uses closed-form
+	math, so it's the one to use anywhere near the trace loop.
+
+	Uses the same layout and indexing as matrix: (x, y) is column x, row y,
+	and translation lives in column 3.
+*/
+
+#include "vector.hpp"
+#include "matrix.hpp"
+
+struct alignas(16) mat4 final {
+private:
+	//Row-major, same as matrix::_ind
+	float m[16];
+
+	static constexpr int _ind(const int& x, const int& y) { return x + y * 4; }
+
+public:
+	//Factory initializers
+	static mat4 Zero();
+	static mat4 Identity();
+	static mat4 Translate(const Vector3& vec);
+
+	//Uninitialized, like float[16]. Use a factory.
+	mat4() = default;
+
+	//Conversion to and from the general matrix. Throws if it isn't 4x4.
+	explicit mat4(const matrix& mat);
+	matrix ToMatrix() const;
+
+	inline float& operator()(const int& x, const int& y)       { return m[_ind(x, y)]; }
+	inline float        at_c(const int& x, const int& y) const { return m[_ind(x, y)]; }
+
+	//Object transformation
+	inline Vector3 TransformPoint(const Vector3& point) const {
+		return Vector3(
+			m[0]*point.x + m[1]*point.y + m[ 2]*point.z + m[ 3],
+			m[4]*point.x + m[5]*point.y + m[ 6]*point.z + m[ 7],
+			m[8]*point.x + m[9]*point.y + m[10]*point.z + m[11]
+		);
+	}
+
+	inline Vector3 TransformVector(const Vector3& vector) const {
+		return Vector3(
+			m[0]*vector.x + m[1]*vector.y + m[ 2]*vector.z,
+			m[4]*vector.x + m[5]*vector.y + m[ 6]*vector.z,
+			m[8]*vector.x + m[9]*vector.y + m[10]*vector.z
+		);
+	}
+
+	inline Vector3 GetTranslation() const { return Vector3(m[3], m[7], m[11]); }
+
+	//Closed-form. No recursion, no temporaries.
+	mat4 Inverse() const;
+	float Determinant() const;
+	mat4 Transpose() const;
+
+	//Composition: (a*b).TransformPoint(p) == a.TransformPoint(b.TransformPoint(p))
+	mat4 operator*(const mat4& rhs) const;
+};
@@ -20,9 +20,15 @@
 	matrix.hpp
 
 	Defines the Matrix class, a powerful (albeit overscoped) solution to
-	arbitrary object transformation. Due to remnants of my Java programming,
-	any advanced math functions are non-performant due to repeated memory
-	allocation and deallocations
+	arbitrary object transformation.
+
+	Transpose, CheckerboardSign, scaling and multiplication are lazy: they
+	return small expression objects instead of matrices, and nothing is
+	computed until the expression is assigned to a matrix. That assignment
+	evaluates the whole chain in one loop, straight into the matrix's own
+	storage, so `matrix adj = m.Cofactor().Transpose() / det;` allocates
+	once. Expressions only reference the matrices they read, so don't keep
+	one (or an `auto` holding one) past the statement that made it.
 
 	Adapted from `Matrix` by myself, in `rm's Bukkit Common API` (private codebase available upon request)
 */
@@ -30,47 +36,233 @@
 #include "vector.hpp"
 
 #include <vector>
+#include <stdexcept>
+#include <memory_resource>
+
+class matrix;
+
+template<typename E> class matrix_transpose;
+template<typename E> class matrix_checkerboard;
+template<typename E> class matrix_scale;
+template<typename E> class matrix_quotient;
+template<typename A, typename B> class matrix_product;
+
+//Matrices are held by reference, since copying one means allocating. Every other
+//expression is a few references and floats, so it's held by value.
+template<typename E> struct matrix_operand { using type = const E; };
+template<> struct matrix_operand<matrix> { using type = const matrix&; };
+
+#pragma region Expressions
+
+//Base of matrix and of every lazy expression over matrices. E must have
+//`const int size`, `float eval(x, y)` (no bounds checks), and `bool reads(const matrix&)`.
+template<typename E>
+class matrix_expr {
+public:
+	inline const E& self() const { return static_cast<const E&>(*this); }
+
+	inline matrix_transpose<E> Transpose() const;
+	inline matrix_checkerboard<E> CheckerboardSign() const;
+};
+
+template<typename E>
+class matrix_transpose final : public matrix_expr<matrix_transpose<E>> {
+private:
+	typename matrix_operand<E>::type e;
+public:
+	const int size;
+	explicit matrix_transpose(const E& e) : e{ e }, size{ e.size } {}
+
+	inline float eval(const int& x, const int& y) const { return e.eval(y, x); }
+	inline bool reads(const matrix& mat) const { return e.reads(mat); }
+};
+
+template<typename E>
+class matrix_checkerboard final : public matrix_expr<matrix_checkerboard<E>> {
+private:
+	typename matrix_operand<E>::type e;
+public:
+	const int size;
+	explicit matrix_checkerboard(const E& e) : e{ e }, size{ e.size } {}
+
+	//Negative wherever x and y differ in parity
+	inline float eval(const int& x, const int& y) const { return ((x ^ y) & 1) ? -e.eval(x, y) : e.eval(x, y); }
+	inline bool reads(const matrix& mat) const { return e.reads(mat); }
+};
+
+template<typename E>
+class matrix_scale final : public matrix_expr<matrix_scale<E>> {
+private:
+	typename matrix_operand<E>::type e;
+	const float s;
+public:
+	const int size;
+	matrix_scale(const E& e, const float& s) : e{ e }, s{ s }, size{ e.size } {}
+
+	inline float eval(const int& x, const int& y) const { return e.eval(x, y) * s; }
+	inline bool reads(const matrix& mat) const { return e.reads(mat); }
+};
+
+//Separate from matrix_scale so `m / det` rounds the same as dividing each element
+template<typename E>
+class matrix_quotient final : public matrix_expr<matrix_quotient<E>> {
+private:
+	typename matrix_operand<E>::type e;
+	const float s;
+public:
+	const int size;
+	matrix_quotient(const E& e, const float& s) : e{ e }, s{ s }, size{ e.size } {}
+
+	inline float eval(const int& x, const int& y) const { return e.eval(x, y) / s; }
+	inline bool reads(const matrix& mat) const { return e.reads(mat); }
+};
 
-class matrix final {
+//Every element re-reads a whole row of a and column of b, so a product of products
+//costs O(n) per element per level. Assign inner products to a matrix first.
+template<typename A, typename B>
+class matrix_product final : public matrix_expr<matrix_product<A, B>> {
 private:
+	typename matrix_operand<A>::type a;
+	typename matrix_operand<B>::type b;
+public:
+	const int size;
+	matrix_product(const A& a, const B& b) : a{ a }, b{ b }, size{ a.size }
+	{
+		if (a.size != b.size) throw std::invalid_argument("Can't multiply matrices of different sizes!");
+	}
+
+	//Row y of a dotted with column x of b
+	inline float eval(const int& x, const int& y) const
+	{
+		float sum = 0;
+		for (int i = 0; i < size; i++) sum += a.eval(i, y) * b.eval(x, i);
+		return sum;
+	}
+	inline bool reads(const matrix& mat) const { return a.reads(mat) || b.reads(mat); }
+};
+
+template<typename E> inline matrix_transpose<E> matrix_expr<E>::Transpose() const { return matrix_transpose<E>(self()); }
+template<typename E> inline matrix_checkerboard<E> matrix_expr<E>::CheckerboardSign() const { return matrix_checkerboard<E>(self()); }
+
+template<typename E> inline matrix_scale<E> operator*(const matrix_expr<E>& e, const float& s) { return matrix_scale<E>(e.self(), s); }
+template<typename E> inline matrix_scale<E> operator*(const float& s, const matrix_expr<E>& e) { return matrix_scale<E>(e.self(), s); }
+template<typename E> inline matrix_quotient<E> operator/(const matrix_expr<E>& e, const float& s) { return matrix_quotient<E>(e.self(), s); }
+
+template<typename A, typename B>
+inline matrix_product<A, B> operator*(const matrix_expr<A>& a, const matrix_expr<B>& b) { return matrix_product<A, B>(a.self(), b.self()); }
+
+#pragma endregion
+
+class matrix final : public matrix_expr<matrix> {
+private:
+	//Where m came from. Every matrix derived from this one (Inverse, Minors...) comes from here too.
+	std::pmr::memory_resource* const mem;
+
 	//Contains all internal values. 1D to avoid "pointer-to-pointer" BS.
-	//Should always be indexed through _ind, like image.
-	float* const m;
-	inline int _ind(int x, int y) const;
+	//Should always be indexed through _ind, like image. nullptr once moved from.
+	float* m;
+	inline int _ind(int x, int y) const {
+		if (x < 0 || x >= size || y < 0 || y >= size) throw std::invalid_argument("Index out of bounds!");
+		return x + y * size;
+	}
 
 	//Private to force use of factory initialization
-	matrix(int _size);
+	matrix(int _size, std::pmr::memory_resource* mem);
+
+	inline float* _allocate() const { return (float*)mem->allocate(sizeof(float) * size * size, alignof(float)); }
 public:
-	//Factory initializers
-	static matrix Zero(int _size);
-	static matrix Identity(int _size);
-	static matrix Translate(Vector3 vec);
+	//Factory initializers. Pass an Arena to keep temporaries off the heap.
+	static matrix Zero(int _size, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+	static matrix Identity(int _size, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+	static matrix Translate(Vector3 vec, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
 	//I could implement more (scale, shear, rotate) but I don't see a reason to
 
 	//Matrices described by this class are square. This describes either of its dimensions.
 	const int size;
 
-	//Copy values, not pointer addresses
+	//Copy values, not pointer addresses. Like pmr containers, copies don't inherit cpy's
+	//resource, since a copy can easily outlive an Arena the original came from.
 	matrix(const matrix& cpy);
+	matrix(const matrix& cpy, std::pmr::memory_resource* mem);
+
+	//Takes mov's storage (and so its resource). mov can only be destroyed or assigned to afterwards.
+	matrix(matrix&& mov) noexcept;
+
+	//Evaluates an expression in one pass. Implicit, so `matrix t = m.Transpose();` just works.
+	template<typename E>
+	matrix(const matrix_expr<E>& expr, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+
+	//Sizes can't change, so these throw if rhs is a different size
 	matrix& operator=(const matrix& rhs);
+	matrix& operator=(matrix&& rhs);
+	template<typename E>
+	matrix& operator=(const matrix_expr<E>& expr);
+
+	~matrix();
+
+	inline std::pmr::memory_resource* GetResource() const { return mem; }
 
 	//Ideally would be [] but C++ doesn't support 2D indices
 	inline float& operator()(const int& x, const int& y)       { return m[_ind(x, y)]; }
 	inline float        at_c(const int& x, const int& y) const { return m[_ind(x, y)]; }
 
+	//Unchecked, for expressions
+	inline float eval(const int& x, const int& y) const { return m[x + y * size]; }
+	inline bool reads(const matrix& mat) const { return this == &mat; }
+
 	//Object transformation
 	Vector3 TransformPoint (const Vector3& point ) const;
 	Vector3 TransformVector(const Vector3& vector) const;
 
 	//Bunch of costly advanced maths. More complex = more costly
+	//Inverse, Determinant and Solve go through an LU decomposition, so they're O(n^3)
 	matrix Inverse() const;
 	float Determinant() const;
+
+	//x such that this * x = b, for column vectors x and b of length size. Throws if there's no unique solution.
+	std::vector<float> Solve(const std::vector<float>& b) const;
+	void Solve(const float* b, float* x) const;
+
+	//Replaces this matrix with its LU decomposition, with partial pivoting: rows of L*U are
+	//rows pivots[0], pivots[1]... of the original. U is on and above the diagonal, L below it
+	//(its diagonal is all 1s, and not stored). pivots needs room for size ints.
+	//Returns the sign of the row permutation, or 0 if the matrix is singular.
+	int DecomposeLU(int* pivots);
+
+	//Solve, for a matrix that's already been through DecomposeLU. O(n^2), so decompose once
+	//and call this for every right-hand side.
+	void SolveLU(const int* pivots, const float* b, float* x) const;
+
 	matrix DropXY(const int& x, const int& y) const;
 	matrix Adjugate() const;
 	matrix Cofactor() const;
-	matrix Transpose() const;
 	matrix Minors() const;
-	matrix CheckerboardSign() const;
+	//Transpose and CheckerboardSign come from matrix_expr, and are lazy
+
+	matrix& operator*=(const matrix& rhs);
+};
+
+template<typename E>
+matrix::matrix(const matrix_expr<E>& expr, std::pmr::memory_resource* mem) :
+	matrix(expr.self().size, mem)
+{
+	const E& e = expr.self();
+	for (int y = 0; y < size; y++) for (int x = 0; x < size; x++) m[x + y * size] = e.eval(x, y);
+}
+
+template<typename E>
+matrix& matrix::operator=(const matrix_expr<E>& expr)
+{
+	const E& e = expr.self();
+	if (e.size != size) throw std::invalid_argument("Can't assign matrices of different sizes!");
 
-	matrix operator*=(matrix& rhs) const;
-};
\ No newline at end of file
+	//Evaluating in place would overwrite values the expression hasn't read yet (think
+	//m = m.Transpose()), so if it reads this matrix, evaluate to the side and swap
+	float* out = (m == nullptr || e.reads(*this)) ? _allocate() : m;
+	for (int y = 0; y < size; y++) for (int x = 0; x < size; x++) out[x + y * size] = e.eval(x, y);
+	if (out != m) {
+		if (m != nullptr) mem->deallocate(m, sizeof(float) * size * size, alignof(float));
+		m = out;
+	}
+	return *this;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	mesh.hpp
+
+	Defines triangle meshes. mesh_buffers is the raw geometry, a vertex
+	buffer and an index buffer, immutable and shared by every mesh (or
+	every thread) that uses it. It can be built from arrays, or loaded
+	from a .gpm file by mapping it: vertices and indices are read straight
+	out of the mapping, so there's no parsing and no copy.
+
+	.gpm files are little-endian:
+		mesh_file_header                     16 bytes
+		float    vertices[vertexCount * 3]   xyz triples
+		uint32_t indices [triangleCount * 3] three vertices per triangle
+
+	TriangleMesh is the Traceable. It builds a bvh_tree with ray_packet::WIDTH
+	triangles per leaf, and repacks each leaf into a triangle_block, so a
+	ray tests a whole leaf with one SIMD Moller-Trumbore. Meshes have no
+	transform of their own; place copies of one with InstanceSet.
+*/
+
+#include "raytrace.hpp"
+#include "bvh.hpp"
+#include "packet.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class mapped_file;
+
+struct mesh_file_header final {
+public:
+	static constexpr uint32_t MAGIC = 0x534D5047; //"GPMS", read as a little-endian uint32_t
+	static constexpr uint32_t VERSION = 1;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+
+class mesh_buffers final {
+public:
+	//Copies the arrays. Throws if indices isn't whole triangles, or points past the last vertex.
+	static std::shared_ptr<const mesh_buffers> FromArrays(const std::vector<Vector3>& vertices, const std::vector<uint32_t>& indices);
+
+	//Maps a .gpm file. Throws std::runtime_error if it isn't one, or is truncated or corrupt.
+	static std::shared_ptr<const mesh_buffers> Load(const std::string& path);
+
+	//In .gpm format. out must be opened with std::ios::binary. Throws std::invalid_argument if out
+	//isn't open, and std::runtime_error if it fails partway.
+	void write_to(std::ostream& out) const;
+
+	~mesh_buffers();
+
+	inline int GetVertexCount  () const { return (int)vertexCount; }
+	inline int GetTriangleCount() const { return (int)triangleCount; }
+
+	inline Vector3 GetVertex(const int& index) const { return Vector3(vertices[3*index], vertices[3*index+1], vertices[3*index+2]); }
+	inline const uint32_t* GetTriangle(const int& triangle) const { return indices + 3*triangle; }
+
+private:
+	mesh_buffers();
+
+	//Point into owned or file, whichever holds the data
+	const float* vertices;
+	const uint32_t* indices;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+
+	std::vector<float> ownedVertices;
+	std::vector<uint32_t> ownedIndices;
+	std::unique_ptr<mapped_file> file;
+
+	//Whether every index points at a vertex
+	bool validate() const;
+};
+
+class TriangleMesh final : public Traceable {
+public:
+	//Builds the tree right away, from mem. buffers can be shared with any number of other meshes.
+	explicit TriangleMesh(std::shared_ptr<const mesh_buffers> buffers, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+
+	//Reported by every hit, same as Sphere's red
+	Color color;
+
+	inline const mesh_buffers& GetBuffers() const { return *buffers; }
+	inline const bvh_tree& GetTree() const { return tree; }
+
+	using Traceable::trace;
+	virtual void trace(const Ray& ray, hit_buffer& out) override;
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) override;
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max) override;
+	virtual void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes) override;
+	virtual aabb bounds() const override;
+
+	//Ambiguous where triangles meet, so hits carry their own. Use trace_hit::normal instead.
+	virtual Vector3 normal_at(const Vector3& pos) override;
+
+private:
+	//One bvh leaf, structure-of-arrays: a vertex and two edges of each triangle, one per lane.
+	//Spare lanes are zeroed, which makes them degenerate, and they never hit.
+	//A leaf bigger than WIDTH (only when triangles can't be split apart) gets several blocks in a row.
+	struct alignas(sizeof(float) * ray_packet::WIDTH) triangle_block final {
+		float v0x[ray_packet::WIDTH], v0y[ray_packet::WIDTH], v0z[ray_packet::WIDTH];
+		float e1x[ray_packet::WIDTH], e1y[ray_packet::WIDTH], e1z[ray_packet::WIDTH];
+		float e2x[ray_packet::WIDTH], e2y[ray_packet::WIDTH], e2z[ray_packet::WIDTH];
+		int triangle[ray_packet::WIDTH]; //Index into buffers, or -1 for a spare lane
+	};
+
+	std::shared_ptr<const mesh_buffers> buffers;
+	bvh_tree tree;
+	std::pmr::vector<triangle_block> blocks; //Leaf by leaf
+	std::pmr::vector<int> blockOf;           //First block of each leaf node, by node index. -1 for interior nodes.
+
+	//Lanes of block b the ray hits within (t_min, t_max), as a bitmask, with each one's distance in t
+	int intersect(const int& b, const Ray& ray, const float& t_min, const float& t_max, float* t) const;
+
+	inline int blockAt(const bvh_node& leaf) const { return blockOf[&leaf - tree.nodes.data()]; }
+
+	//Hit record for a triangle the ray hit at t
+	void makeHit(const int& triangle, const Ray& ray, const float& t, trace_hit& out) const;
+};
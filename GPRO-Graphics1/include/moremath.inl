@@ -61,7 +61,7 @@ public:
 
 	inline float getSolution(const int& which) {
 		if (which < 0 || which >= getSolutionCount()) throw std::invalid_argument("Solution out of bounds");
-		if (which == 1) return (-b + sqrtf(discriminant())) /4/a/c;
-		else return (-b - sqrtf(discriminant())) /4/a/c;
+		if (which == 1) return (-b + sqrtf(discriminant())) /2/a;
+		else return (-b - sqrtf(discriminant())) /2/a;
 	}
 };
\ No newline at end of file
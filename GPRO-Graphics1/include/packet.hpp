@@ -0,0 +1,188 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	packet.hpp
+
+	Defines ray_packet, a structure-of-arrays bundle of rays that get
+	traced together, and pfloat/pmask, which do one float (or comparison)
+	per ray in a single instruction. Packet width is picked at compile time:
+	8 on AVX builds, 4 on SSE2, and 4 on the scalar fallback (which loops,
+	but keeps the same interface so kernels are only written once).
+
+	Every pfloat op is a single IEEE op per lane, so a kernel written in the
+	same order as its scalar counterpart gives the same results.
+*/
+
+#include "rawdata.hpp"
+#include "ray.hpp"
+
+#if !defined(GPRO_NO_SIMD) && defined(__AVX__)
+#define GPRO_PACKET_AVX
+#define GPRO_PACKET_WIDTH 8
+#include <immintrin.h>
+#elif defined(GPRO_SIMD_SSE)
+#define GPRO_PACKET_SSE
+#define GPRO_PACKET_WIDTH 4
+#else
+#define GPRO_PACKET_WIDTH 4
+#endif
+
+#pragma region pfloat/pmask
+
+#if defined(GPRO_PACKET_AVX)
+
+struct pmask final {
+	__m256 v;
+	inline pmask(const __m256& _v) : v(_v) {}
+	inline pmask operator&(const pmask& rhs) const { return _mm256_and_ps(v, rhs.v); }
+	inline pmask operator|(const pmask& rhs) const { return _mm256_or_ps (v, rhs.v); }
+	inline int Bits() const { return _mm256_movemask_ps(v); } //Bit i is lane i
+};
+
+struct pfloat final {
+	__m256 v;
+	pfloat() = default;
+	inline pfloat(const __m256& _v) : v(_v) {}
+	inline explicit pfloat(const float& f) : v(_mm256_set1_ps(f)) {}
+
+	static inline pfloat Load(const float* p) { return _mm256_load_ps(p); } //p must be 32-byte aligned
+	inline void Store(float* p) const { _mm256_store_ps(p, v); }
+
+	inline pfloat operator-() const { return _mm256_xor_ps(v, _mm256_set1_ps(-0.0f)); }
+	inline pfloat operator+(const pfloat& rhs) const { return _mm256_add_ps(v, rhs.v); }
+	inline pfloat operator-(const pfloat& rhs) const { return _mm256_sub_ps(v, rhs.v); }
+	inline pfloat operator*(const pfloat& rhs) const { return _mm256_mul_ps(v, rhs.v); }
+	inline pfloat operator/(const pfloat& rhs) const { return _mm256_div_ps(v, rhs.v); }
+
+	inline pmask operator< (const pfloat& rhs) const { return _mm256_cmp_ps(v, rhs.v, _CMP_LT_OQ); }
+	inline pmask operator> (const pfloat& rhs) const { return _mm256_cmp_ps(v, rhs.v, _CMP_GT_OQ); }
+	inline pmask operator<=(const pfloat& rhs) const { return _mm256_cmp_ps(v, rhs.v, _CMP_LE_OQ); }
+	inline pmask operator>=(const pfloat& rhs) const { return _mm256_cmp_ps(v, rhs.v, _CMP_GE_OQ); }
+
+	static inline pfloat Sqrt(const pfloat& x) { return _mm256_sqrt_ps(x.v); }
+	static inline pfloat Min (const pfloat& a, const pfloat& b) { return _mm256_min_ps(a.v, b.v); }
+	static inline pfloat Max (const pfloat& a, const pfloat& b) { return _mm256_max_ps(a.v, b.v); }
+	static inline pfloat Select(const pmask& m, const pfloat& ifTrue, const pfloat& ifFalse) { return _mm256_blendv_ps(ifFalse.v, ifTrue.v, m.v); }
+};
+
+#elif defined(GPRO_PACKET_SSE)
+
+struct pmask final {
+	__m128 v;
+	inline pmask(const __m128& _v) : v(_v) {}
+	inline pmask operator&(const pmask& rhs) const { return _mm_and_ps(v, rhs.v); }
+	inline pmask operator|(const pmask& rhs) const { return _mm_or_ps (v, rhs.v); }
+	inline int Bits() const { return _mm_movemask_ps(v); } //Bit i is lane i
+};
+
+struct pfloat final {
+	__m128 v;
+	pfloat() = default;
+	inline pfloat(const __m128& _v) : v(_v) {}
+	inline explicit pfloat(const float& f) : v(_mm_set1_ps(f)) {}
+
+	static inline pfloat Load(const float* p) { return _mm_load_ps(p); } //p must be 16-byte aligned
+	inline void Store(float* p) const { _mm_store_ps(p, v); }
+
+	inline pfloat operator-() const { return _mm_xor_ps(v, _mm_set1_ps(-0.0f)); }
+	inline pfloat operator+(const pfloat& rhs) const { return _mm_add_ps(v, rhs.v); }
+	inline pfloat operator-(const pfloat& rhs) const { return _mm_sub_ps(v, rhs.v); }
+	inline pfloat operator*(const pfloat& rhs) const { return _mm_mul_ps(v, rhs.v); }
+	inline pfloat operator/(const pfloat& rhs) const { return _mm_div_ps(v, rhs.v); }
+
+	inline pmask operator< (const pfloat& rhs) const { return _mm_cmplt_ps(v, rhs.v); }
+	inline pmask operator> (const pfloat& rhs) const { return _mm_cmpgt_ps(v, rhs.v); }
+	inline pmask operator<=(const pfloat& rhs) const { return _mm_cmple_ps(v, rhs.v); }
+	inline pmask operator>=(const pfloat& rhs) const { return _mm_cmpge_ps(v, rhs.v); }
+
+	static inline pfloat Sqrt(const pfloat& x) { return _mm_sqrt_ps(x.v); }
+	static inline pfloat Min (const pfloat& a, const pfloat& b) { return _mm_min_ps(a.v, b.v); }
+	static inline pfloat Max (const pfloat& a, const pfloat& b) { return _mm_max_ps(a.v, b.v); }
+	//SSE2 has no blend, so mask it together by hand
+	static inline pfloat Select(const pmask& m, const pfloat& ifTrue, const pfloat& ifFalse) { return _mm_or_ps(_mm_and_ps(m.v, ifTrue.v), _mm_andnot_ps(m.v, ifFalse.v)); }
+};
+
+#else
+
+//Scalar fallback. Loops, but lets packet kernels compile anywhere.
+struct pmask final {
+	int bits;
+	inline pmask(const int& _bits) : bits(_bits) {}
+	inline pmask operator&(const pmask& rhs) const { return bits & rhs.bits; }
+	inline pmask operator|(const pmask& rhs) const { return bits | rhs.bits; }
+	inline int Bits() const { return bits; }
+};
+
+struct pfloat final {
+	float v[GPRO_PACKET_WIDTH];
+	pfloat() = default;
+	inline explicit pfloat(const float& f) { for (int i = 0; i < GPRO_PACKET_WIDTH; i++) v[i] = f; }
+
+	static inline pfloat Load(const float* p) { pfloat o; for (int i = 0; i < GPRO_PACKET_WIDTH; i++) o.v[i] = p[i]; return o; }
+	inline void Store(float* p) const { for (int i = 0; i < GPRO_PACKET_WIDTH; i++) p[i] = v[i]; }
+
+#define PFLOAT_LANEWISE(expr) pfloat o; for (int i = 0; i < GPRO_PACKET_WIDTH; i++) o.v[i] = (expr); return o;
+#define PFLOAT_COMPARE(op) int bits = 0; for (int i = 0; i < GPRO_PACKET_WIDTH; i++) if (v[i] op rhs.v[i]) bits |= 1 << i; return bits;
+	inline pfloat operator-() const { PFLOAT_LANEWISE(-v[i]) }
+	inline pfloat operator+(const pfloat& rhs) const { PFLOAT_LANEWISE(v[i] + rhs.v[i]) }
+	inline pfloat operator-(const pfloat& rhs) const { PFLOAT_LANEWISE(v[i] - rhs.v[i]) }
+	inline pfloat operator*(const pfloat& rhs) const { PFLOAT_LANEWISE(v[i] * rhs.v[i]) }
+	inline pfloat operator/(const pfloat& rhs) const { PFLOAT_LANEWISE(v[i] / rhs.v[i]) }
+
+	inline pmask operator< (const pfloat& rhs) const { PFLOAT_COMPARE(< ) }
+	inline pmask operator> (const pfloat& rhs) const { PFLOAT_COMPARE(> ) }
+	inline pmask operator<=(const pfloat& rhs) const { PFLOAT_COMPARE(<=) }
+	inline pmask operator>=(const pfloat& rhs) const { PFLOAT_COMPARE(>=) }
+
+	static inline pfloat Sqrt(const pfloat& x) { PFLOAT_LANEWISE(sqrtf(x.v[i])) }
+	static inline pfloat Min (const pfloat& a, const pfloat& b) { PFLOAT_LANEWISE(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+	static inline pfloat Max (const pfloat& a, const pfloat& b) { PFLOAT_LANEWISE(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+	static inline pfloat Select(const pmask& m, const pfloat& ifTrue, const pfloat& ifFalse) { PFLOAT_LANEWISE(((m.bits >> i) & 1) ? ifTrue.v[i] : ifFalse.v[i]) }
+#undef PFLOAT_LANEWISE
+#undef PFLOAT_COMPARE
+};
+
+#endif
+
+#pragma endregion pfloat/pmask
+
+//Structure-of-arrays bundle of GPRO_PACKET_WIDTH rays. Lanes that aren't in
+//use should still hold a valid ray (a copy of a used lane is fine), since
+//kernels compute every lane and only mask off the results.
+struct ray_packet final {
+public:
+	static constexpr int WIDTH = GPRO_PACKET_WIDTH;
+	static constexpr int ALL_LANES = (1 << WIDTH) - 1;
+
+	alignas(32) float ox[WIDTH];
+	alignas(32) float oy[WIDTH];
+	alignas(32) float oz[WIDTH];
+	alignas(32) float dx[WIDTH];
+	alignas(32) float dy[WIDTH];
+	alignas(32) float dz[WIDTH];
+
+	inline void SetRay(const int& lane, const Ray& ray) {
+		ox[lane] = ray.origin.x;    oy[lane] = ray.origin.y;    oz[lane] = ray.origin.z;
+		dx[lane] = ray.direction.x; dy[lane] = ray.direction.y; dz[lane] = ray.direction.z;
+	}
+
+	inline Ray GetRay(const int& lane) const {
+		return Ray(Vector3(ox[lane], oy[lane], oz[lane]), Vector3(dx[lane], dy[lane], dz[lane]));
+	}
+};
@@ -20,8 +20,11 @@
 	rawdata.hpp
 	
 	Contains basic boilerplate data types such as float4 and int3. All member
-	variables are given deliberately vague names, which are accessed by
-	reference as RGB or XYZ in children.
+	variables are given deliberately vague names. float3 also overlays them
+	with XYZ and RGB names, which children expose as needed.
+
+	Everything here is trivially copyable and exactly the size of its
+	components, so arrays of them can be memcpy'd and vectorized.
 	
 	These are loosely based on:
 	 - `vec3` by Dan Buckstein in his starter framework
@@ -32,6 +35,17 @@
 
 #include "pointlesskw.h"
 
+#include <type_traits>
+
+//SSE2 is baseline on every x64 compiler, so float3/float4 math uses it there
+//by default. AVX builds get the same code VEX-encoded by the compiler.
+//Define GPRO_NO_SIMD to force the portable scalar path. Both paths perform the
+//same IEEE operations in the same order, so their results are identical.
+#if !defined(GPRO_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define GPRO_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
 //TODO add int2, float2
 
 struct float3;
@@ -45,7 +59,7 @@ protected:
 	explicit int3() = default; //Zero ctor
 	explicit int3(int _x, int _y, int _z); //Component ctor
 	explicit int3(float _x, float _y, float _z); //Conversion-component ctor
-	implicit int3(const int3& cpy); //Copy ctor
+	implicit int3(const int3& cpy) = default; //Copy ctor
 
 public:
 	inline int3 operator+(const int3& rhs) const;
@@ -54,7 +68,7 @@ public:
 	friend int3 operator*(const float& lhs, const int3& rhs); //Mul by scalar backwards (calls int3*float)
 	inline int3 operator/(const float& rhs) const;
 
-	int3& operator=(const int3& rhs);
+	int3& operator=(const int3& rhs) = default;
 	int3& operator+=(const int3& rhs);
 	int3& operator-=(const int3& rhs);
 	int3& operator*=(const float& rhs);
@@ -65,14 +79,25 @@ public:
 //Used primarily for vectors in Euclidean space, and fresh RGB color data.
 struct float3 {
 protected:
-	//Member variables
-	float val0, val1, val2;
+	//Member variables. Each union is a single float with several names:
+	//Vector3 exposes x/y/z and Color exposes r/g/b through using-declarations.
+	//This replaces the reference members children used to carry, which
+	//tripled their size and made them non-trivially-copyable.
+	union { float val0; float x; float r; };
+	union { float val1; float y; float g; };
+	union { float val2; float z; float b; };
 
 	explicit float3() = default; //Zero ctor
 	explicit float3(float _x, float _y, float _z); //Component ctor
 
+#ifdef GPRO_SIMD_SSE
+	//Register conversion. Lane 3 is always 0, so it never affects horizontal sums.
+	inline __m128 _load() const { return _mm_set_ps(0, val2, val1, val0); }
+	static inline float3 _store(const __m128& v);
+#endif
+
 public:
-	implicit float3(const float3& cpy); //Copy ctor
+	implicit float3(const float3& cpy) = default; //Copy ctor
 
 	inline float3 operator-() const; //Unary negation
 	inline float3 operator+(const float3& rhs) const;
@@ -81,7 +106,7 @@ public:
 	friend float3 operator*(const float& lhs, const float3& rhs); //Mul by scalar backwards (calls float3*float)
 	inline float3 operator/(const float& rhs) const;
 
-	float3& operator=(const float3& rhs);
+	float3& operator=(const float3& rhs) = default;
 	float3& operator+=(const float3& rhs);
 	float3& operator-=(const float3& rhs);
 	float3& operator*=(const float& rhs);
@@ -90,14 +115,20 @@ public:
 };
 
 //Used primarily for quaternion rotations, and fresh RGBA color data.
-struct float4 {
+struct alignas(16) float4 {
 protected:
 	//Member variables
 	float val0, val1, val2, val3;
 
 	explicit float4() = default; //Zero ctor
 	explicit float4(float _w, float _x, float _y, float _z); //Component ctor
-	implicit float4(const float4& cpy); //Copy ctor
+	implicit float4(const float4& cpy) = default; //Copy ctor
+
+#ifdef GPRO_SIMD_SSE
+	//Register conversion. float4 fills a register exactly.
+	inline __m128 _load() const { return _mm_set_ps(val3, val2, val1, val0); }
+	static inline float4 _store(const __m128& v);
+#endif
 
 public:
 	inline float4 operator+(const float4& rhs) const;
@@ -106,10 +137,151 @@ public:
 	friend float4 operator*(const float& lhs, const float4& rhs); //Mul by scalar backwards (calls float4*float)
 	inline float4 operator/(const float& rhs) const;
 
-	float4& operator=(const float4& rhs);
+	float4& operator=(const float4& rhs) = default;
 	float4& operator+=(const float4& rhs);
 	float4& operator-=(const float4& rhs);
 	float4& operator*=(const float& rhs);
 	float4& operator/=(const float& rhs);
 
-};
\ No newline at end of file
+};
+
+static_assert(sizeof(int3  ) == 3*sizeof(int  ), "int3 must be tightly packed");
+static_assert(sizeof(float3) == 3*sizeof(float), "float3 must be tightly packed");
+static_assert(sizeof(float4) == 4*sizeof(float), "float4 must be tightly packed");
+static_assert(std::is_trivially_copyable<int3  >::value, "int3 must be trivially copyable");
+static_assert(std::is_trivially_copyable<float3>::value, "float3 must be trivially copyable");
+static_assert(std::is_trivially_copyable<float4>::value, "float4 must be trivially copyable");
+
+//float3 and float4 are on every ray's critical path, so their math lives here
+//where it can be inlined, rather than behind a call into rawdata.cpp.
+
+#pragma region float3
+
+inline float3::float3(float _x, float _y, float _z) : val0(_x), val1(_y), val2(_z)
+{ }
+
+#ifdef GPRO_SIMD_SSE
+inline float3 float3::_store(const __m128& v)
+{
+	return float3(
+		_mm_cvtss_f32(v),
+		_mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))),
+		_mm_cvtss_f32(_mm_movehl_ps(v, v))
+	);
+}
+#endif
+
+inline float3 float3::operator-() const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_xor_ps(_load(), _mm_set1_ps(-0.0f))); //Flip sign bits
+#else
+	return float3(-val0, -val1, -val2);
+#endif
+}
+
+inline float3 float3::operator+(const float3& rhs) const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_add_ps(_load(), rhs._load()));
+#else
+	return float3(this->val0 + rhs.val0, this->val1 + rhs.val1, this->val2 + rhs.val2);
+#endif
+}
+
+inline float3 float3::operator-(const float3& rhs) const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_sub_ps(_load(), rhs._load()));
+#else
+	return float3(this->val0 - rhs.val0, this->val1 - rhs.val1, this->val2 - rhs.val2);
+#endif
+}
+
+inline float3 float3::operator*(const float& rhs) const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_mul_ps(_load(), _mm_set1_ps(rhs)));
+#else
+	return float3(this->val0 * rhs, this->val1 * rhs, this->val2 * rhs);
+#endif
+}
+
+//Allows float*float3 as well
+inline float3 operator*(const float& lhs, const float3& rhs) { return rhs * lhs; }
+
+inline float3 float3::operator/(const float& rhs) const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_div_ps(_load(), _mm_set1_ps(rhs)));
+#else
+	return float3(this->val0 / rhs, this->val1 / rhs, this->val2 / rhs);
+#endif
+}
+
+inline float3& float3::operator+=(const float3& rhs) { return *this = *this + rhs; }
+inline float3& float3::operator-=(const float3& rhs) { return *this = *this - rhs; }
+inline float3& float3::operator*=(const float& rhs) { return *this = *this * rhs; }
+inline float3& float3::operator/=(const float& rhs) { return *this = *this / rhs; }
+
+#pragma endregion float3
+
+#pragma region float4
+
+inline float4::float4(float _w, float _x, float _y, float _z) : val0(_w), val1(_x), val2(_y), val3(_z)
+{ }
+
+#ifdef GPRO_SIMD_SSE
+inline float4 float4::_store(const __m128& v)
+{
+	float4 out;
+	_mm_store_ps(&out.val0, v); //float4 is 16-byte aligned, and val0..val3 are contiguous
+	return out;
+}
+#endif
+
+inline float4 float4::operator+(const float4& rhs) const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_add_ps(_load(), rhs._load()));
+#else
+	return float4(this->val0+rhs.val0, this->val1+rhs.val1, this->val2+rhs.val2, this->val3+rhs.val3);
+#endif
+}
+
+inline float4 float4::operator-(const float4& rhs) const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_sub_ps(_load(), rhs._load()));
+#else
+	return float4(this->val0-rhs.val0, this->val1-rhs.val1, this->val2-rhs.val2, this->val3-rhs.val3);
+#endif
+}
+
+inline float4 float4::operator*(const float& rhs) const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_mul_ps(_load(), _mm_set1_ps(rhs)));
+#else
+	return float4(this->val0 * rhs, this->val1 * rhs, this->val2 * rhs, this->val3 * rhs);
+#endif
+}
+
+//Allows float*float4 as well
+inline float4 operator*(const float& lhs, const float4& rhs) { return rhs * lhs; }
+
+inline float4 float4::operator/(const float& rhs) const
+{
+#ifdef GPRO_SIMD_SSE
+	return _store(_mm_div_ps(_load(), _mm_set1_ps(rhs)));
+#else
+	return float4(this->val0 / rhs, this->val1 / rhs, this->val2 / rhs, this->val3 / rhs);
+#endif
+}
+
+inline float4& float4::operator+=(const float4& rhs) { return *this = *this + rhs; }
+inline float4& float4::operator-=(const float4& rhs) { return *this = *this - rhs; }
+inline float4& float4::operator*=(const float& rhs) { return *this = *this * rhs; }
+inline float4& float4::operator/=(const float& rhs) { return *this = *this / rhs; }
+
+#pragma endregion float4
\ No newline at end of file
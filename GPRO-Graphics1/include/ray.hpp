@@ -26,6 +26,7 @@
 
 #include "vector.hpp"
 #include "matrix.hpp"
+#include "mat4.hpp"
 
 struct Ray final {
 public:
@@ -38,4 +39,5 @@ public:
 	inline Vector3 GetByDist(const float& d) const { return origin + direction.WithMagnitude(d); }
 
 	inline Ray operator*(const matrix& mat) const { return Ray(mat.TransformPoint(origin), mat.TransformVector(direction)); }
+	inline Ray operator*(const mat4  & mat) const { return Ray(mat.TransformPoint(origin), mat.TransformVector(direction)); }
 };
\ No newline at end of file
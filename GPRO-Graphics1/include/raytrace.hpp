@@ -3,49 +3,101 @@
 #include "vector.hpp"
 #include "ray.hpp"
 #include "matrix.hpp"
+#include "mat4.hpp"
+#include "transform.hpp"
 #include "color.hpp"
+#include "bounds.hpp"
+#include "packet.hpp"
 
 #define ATTR_SHORTCUTS
 #include "attr.inl"
 
 #include <vector>
+#include <memory_resource>
 
 struct trace_hit final {
 public:
 	Vector3 position;
 	Vector3 normal;
 	Color color;
+	float t; //Distance along the ray, in multiples of ray.direction
 
-	trace_hit(const Vector3& pos, const Vector3& nrm, const Color& color) : position{ pos }, normal{ nrm }, color{ color } { }
+	//Empty hit, for callers providing their own storage to trace_closest
+	trace_hit() : t{ 0 } { }
+	trace_hit(const Vector3& pos, const Vector3& nrm, const Color& color, const float& t) : position{ pos }, normal{ nrm }, color{ color }, t{ t } { }
+};
+
+//Reusable storage for Traceable::trace. Back it with an Arena to keep hits off the heap entirely.
+using hit_buffer = std::pmr::vector<trace_hit>;
+
+//Nearest hits for every lane of a ray_packet
+struct packet_hit final {
+public:
+	trace_hit hits[ray_packet::WIDTH]; //Only meaningful for lanes set in mask
+	alignas(32) float t_max[ray_packet::WIDTH]; //Per-lane search limit. Shrinks to each lane's nearest hit as they're found.
+	int mask; //Bit i is set if lane i hit something
+
+	inline explicit packet_hit(const float& t_max_all) : mask{ 0 } {
+		for (int i = 0; i < ray_packet::WIDTH; i++) t_max[i] = t_max_all;
+	}
 };
 
 class Traceable {
 public:
+	virtual ~Traceable() = default;
+
 	virtual Vector3 normal_at(const Vector3& pos) = 0;
-	virtual std::vector<trace_hit> trace(const Ray& ray) = 0;
+
+	//Every hit along the ray. Allocates, so prefer trace_closest or trace_any when rendering.
+	//Default implementation goes through trace(ray, out).
+	virtual std::vector<trace_hit> trace(const Ray& ray);
+
+	//Every hit along the ray, appended to out. Only allocates when out runs out of room,
+	//so reuse one buffer across rays. Default implementation goes through trace(ray).
+	//Implementations must override at least one of the two.
+	virtual void trace(const Ray& ray, hit_buffer& out);
+
+	//Nearest hit with t_min < t < t_max. Writes it into out and returns true if there is one,
+	//otherwise returns false and leaves out untouched. Default implementation goes through trace(ray, out).
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out);
+
+	//Whether anything at all is hit with t_min < t < t_max. Stops at the first hit it finds,
+	//so it's the one to use for occlusion. Default implementation goes through trace(ray, out).
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max);
+
+	//Packet form of trace_closest. For every lane set in lanes, finds the nearest hit with
+	//t_min < t < out.t_max[lane], and if there is one, records it and sets its bit in out.mask.
+	//Default implementation traces the lanes one at a time.
+	virtual void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes);
+
+	//World-space box that fully contains the object. Used by acceleration structures.
+	virtual aabb bounds() const = 0;
 };
 
 class Sphere : public Traceable {
 private:
 	inline Sphere() : Sphere(Vector3::zero(), 1) {}
 
-	matrix _ltw; //Probably overkill.
+	Transform _transform; //Probably overkill. Keeps the inverse and normal matrices cached.
 public:
-	attr<matrix> localToWorld{&_ltw};
-	attr<matrix> worldToLocal{&_ltw,
-		attr_get(matrix) {
-			return _state.Inverse();
-		},
-		attr_set(matrix) {
-			_state = value.Inverse();
-		}
-	};
+	//Both go through _transform, so the inverse is only recomputed when set, never when read
+	ref_attr<Transform, mat4, &Transform::GetLocalToWorld, &Transform::SetLocalToWorld> localToWorld{ &_transform };
+	ref_attr<Transform, mat4, &Transform::GetWorldToLocal, &Transform::SetWorldToLocal> worldToLocal{ &_transform };
 
 	float radius;
 
 	Sphere(const Vector3& _position, const float& _radius);
 	Sphere(const Sphere& cpy) = delete; //I could write this if I wanted to. Too bad I don't
 
-	virtual std::vector<trace_hit> trace(const Ray& ray) override;
+	using Traceable::trace;
+	virtual void trace(const Ray& ray, hit_buffer& out) override;
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) override;
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max) override;
+	virtual void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes) override;
 	virtual Vector3 normal_at(const Vector3& pos) override;
+	virtual aabb bounds() const override;
+
+private:
+	//Nearest root of the ray-sphere quadratic within (t_min, t_max), without building any hit records
+	bool intersect(const Ray& ray, const float& t_min, const float& t_max, float& t) const;
 };
\ No newline at end of file
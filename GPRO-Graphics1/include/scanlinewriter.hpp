@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	scanlinewriter.hpp
+
+	Defines ScanlineWriter, which streams an image to disk a row at a time
+	instead of holding the whole frame. Rows live in a fixed ring of
+	windowRows buffers: the renderer acquires a row, fills it, and submits
+	it, while a dedicated thread encodes and writes finished rows in order.
+	Encoding overlaps with tracing, and memory stays at windowRows rows no
+	matter how tall the image is.
+
+	Output is byte-for-byte what Image::write_to would produce.
+*/
+
+#include "image.hpp"
+
+#include <ostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+class ScanlineWriter final {
+public:
+	static constexpr int DEFAULT_WINDOW_ROWS = 64;
+
+	const int width;
+	const int height;
+	const float color_space;
+	const image_format format;
+	const int windowRows;
+
+	//Writes the header immediately and starts the writer thread. out must outlive the writer.
+	ScanlineWriter(std::ostream& out, const int& width, const int& height, const float& color_space = Image::DEFAULT_COLOR_SPACE, const image_format& format = image_format::P6, const int& windowRows = DEFAULT_WINDOW_ROWS);
+	ScanlineWriter(const ScanlineWriter& cpy) = delete;
+
+	//Abandons any rows not yet submitted. Call finish() to complete the file.
+	~ScanlineWriter();
+
+	//Storage for row y, width pixels long. Blocks until row y - windowRows has been written.
+	//Rows must be acquired in order, from a single thread; they can be filled and submitted from any.
+	Color* acquire(const int& y);
+
+	//Marks row y as filled. It's written once every row above it has been.
+	void submit(const int& y);
+
+	//Call once every row has been submitted. Waits until they're all written, then flushes.
+	//Rethrows anything the writer thread threw.
+	void finish();
+
+private:
+	std::ostream* out;
+	std::vector<Color> rows; //windowRows * width. Row y lives at slot y % windowRows.
+	std::vector<char> ready; //Per slot: has its current row been submitted?
+	int nextToWrite;
+	bool cancelled;
+	std::exception_ptr error;
+
+	std::mutex lock;
+	std::condition_variable rowReady; //Writer waits on this
+	std::condition_variable slotFree; //acquire waits on this
+	std::thread writer;
+
+	void writerMain();
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	scene.hpp
+
+	Defines Scene, a whole renderable scene in flat arrays: spheres (each
+	optionally transformed), the transforms, materials, a bvh_tree over it
+	all, and the Image and Camera settings to render it with. Nothing in
+	it is a pointer, so it saves to and loads from a .gps file as is.
+
+	.gps files are little-endian:
+		scene_file_header                         48 bytes
+		float        materials [materialCount*4]  r, g, b, scale
+		affine       transforms[transformCount]   world to local, 48 bytes each
+		scene_sphere spheres   [sphereCount]      24 bytes each
+		scene_node   nodes     [nodeCount]        32 bytes each, cached files only
+
+	A plain file is just the scene, and the tree is built when it's loaded.
+	A cached file is saved after rebuild(): spheres are already in the
+	tree's leaf order and the nodes come with them, so loading maps the
+	file and points straight into it. Nothing is parsed or sorted, and
+	only the nodes are copied, which makes big scenes start in milliseconds.
+
+		Scene scene;
+		scene.add(Vector3(0, 0, 5), 1.0f);
+		scene.rebuild();
+		scene.write_to(file, scene_format::CACHED);
+		...
+		std::unique_ptr<Scene> loaded = Scene::Load(path);
+		Image viewport(loaded->settings.width, loaded->settings.height, loaded->settings.colorSpace);
+		Camera(viewport, loaded->settings.fov).render(*loaded);
+*/
+
+#include "raytrace.hpp"
+#include "bvh.hpp"
+#include "instance.hpp"
+#include "mat4.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+
+class mapped_file;
+
+//What to render a Scene with
+struct scene_settings final {
+public:
+	int32_t width;    //Image size, in pixels
+	int32_t height;
+	float colorSpace; //Image color_space
+	float fov;        //Camera fov, in radians
+};
+
+//A sphere in its own space. Tightly packed, so arrays of it can be read straight out of a file.
+struct scene_sphere final {
+public:
+	float x, y, z;
+	float radius;
+	int32_t material;  //Index into the Scene's materials, or Scene::NO_MATERIAL
+	int32_t transform; //Index into the Scene's transforms, or Scene::NO_TRANSFORM
+};
+
+//bvh_node as it's stored in a file, so the file doesn't depend on aabb's layout
+struct scene_node final {
+public:
+	float boxMin[3];
+	float boxMax[3];
+	int32_t first;
+	int32_t count;
+};
+
+struct scene_file_header final {
+public:
+	static constexpr uint32_t MAGIC = 0x43535047; //"GPSC", read as a little-endian uint32_t
+	static constexpr uint32_t VERSION = 1;
+	static constexpr uint32_t FLAG_TREE = 1;      //Has nodes, and spheres are in leaf order
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+	uint32_t maxLeafSize;
+	uint32_t materialCount;
+	uint32_t transformCount;
+	uint32_t sphereCount;
+	uint32_t nodeCount;
+	scene_settings settings;
+};
+
+enum class scene_format {
+	PLAIN, //Just the scene. Smallest, and quickest to write, but the tree is rebuilt on every load.
+	CACHED //With the tree, ready to render as soon as it's mapped. Needs an up to date rebuild().
+};
+
+//Call rebuild() after adding anything, before tracing. Not copyable.
+class Scene final : public Traceable {
+public:
+	static constexpr int NO_MATERIAL = -1;  //Sphere's red
+	static constexpr int NO_TRANSFORM = -1;
+
+	//320x180 at 75 degrees, same as the TestConsole's default
+	static scene_settings DefaultSettings();
+
+	scene_settings settings;
+
+	//Spheres, the tree, and everything else come from mem
+	explicit Scene(int maxLeafSize = bvh_tree::DEFAULT_LEAF_SIZE, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+	~Scene();
+
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	//Maps a .gps file. Cached files are used in place and are ready to render; plain ones are
+	//copied out and rebuilt. Throws std::runtime_error if it isn't one, or is truncated or corrupt.
+	static std::unique_ptr<Scene> Load(const std::string& path, std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+
+	//In .gps format. out must be opened with std::ios::binary. Throws std::invalid_argument if
+	//out isn't open, and std::runtime_error if it fails partway. A mapped scene reads from its
+	//file while writing, so out must not be that file: opening it truncates what's being read.
+	void write_to(std::ostream& out, const scene_format& format = scene_format::CACHED) const;
+
+	//Flat color for any sphere that uses it. Returns its index.
+	int addMaterial(const Color& color);
+
+	//Untransformed sphere. Radius must be positive.
+	void add(const Vector3& center, const float& radius, const int& material = NO_MATERIAL);
+	//Unit sphere at the origin, moved into place by localToWorld (which can scale it into an ellipsoid)
+	void add(const mat4& localToWorld, const int& material = NO_MATERIAL);
+
+	void reserve(const int& spheres);
+
+	//Rebuilds the tree. Reorders the spheres into leaf order, so GetSphere(i) changes.
+	void rebuild();
+
+	inline int size() const { return sphereCount; }
+	inline const scene_sphere& GetSphere(const int& i) const { return spheres[i]; }
+	inline const bvh_tree& GetTree() const { return tree; }
+
+	//Whether the spheres are being read straight out of a mapped file
+	inline bool IsMapped() const { return file != nullptr; }
+
+	using Traceable::trace;
+	virtual void trace(const Ray& ray, hit_buffer& out) override;
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) override;
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max) override;
+	virtual void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes) override;
+	virtual aabb bounds() const override;
+
+	//A scene has no surface of its own. Use trace_hit::normal instead.
+	virtual Vector3 normal_at(const Vector3& pos) override;
+
+private:
+	//Point into the owned vectors, or into file, whichever holds the data
+	const scene_sphere* spheres;
+	const affine* transforms;
+	int sphereCount;
+	int transformCount;
+
+	std::pmr::vector<scene_sphere> ownedSpheres;
+	std::pmr::vector<affine> ownedTransforms;
+	std::pmr::vector<Color> materials;
+	bvh_tree tree;
+	int maxLeafSize;
+	bool stale; //Added to since the last rebuild()
+
+	std::unique_ptr<mapped_file> file;
+
+	//Copies mapped arrays into the owned vectors, so they can be changed
+	void detach();
+
+	inline Ray toLocal(const scene_sphere& s, const Ray& ray) const {
+		if (s.transform == NO_TRANSFORM) return ray;
+		const affine& w = transforms[s.transform];
+		return Ray(w.TransformPoint(ray.origin), w.TransformVector(ray.direction));
+	}
+
+	//Both roots of ray-sphere, for a ray already in the sphere's space. False if there are none.
+	static bool solve(const scene_sphere& s, const Ray& local, float& t0, float& t1);
+
+	//Hit record for sphere i, hit at t along the world-space ray
+	trace_hit makeHit(const int& i, const Ray& ray, const float& t) const;
+};
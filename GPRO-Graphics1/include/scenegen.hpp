@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	scenegen.hpp
+
+	Defines SceneGenerator, which makes big procedural scenes for scaling
+	tests: anywhere from a thousand to ten million spheres, spread out
+	uniformly, bunched into clusters, or packed into a grid. The same
+	settings and seed always give the same spheres in the same order.
+
+	Spheres fill region, which by default is what a camera with
+	Scene::DefaultSettings sees. Radii shrink as count grows, so every
+	count fills about the same fraction of it, and renders of different
+	sizes stay comparable.
+
+		SceneGenerator gen(scene_distribution::CLUSTERED, 1000000, 42);
+		std::unique_ptr<Scene> scene = gen.generate();
+		camera.render(*scene);
+
+	write_to skips the Scene and streams a plain .gps file instead, so
+	generating a file never needs every sphere in memory at once.
+*/
+
+#include "scene.hpp"
+#include "bounds.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <ostream>
+
+enum class scene_distribution {
+	UNIFORM,   //Centers anywhere in region, equally likely
+	CLUSTERED, //Centers bunched around random points in region, normally distributed
+	GRID       //Centers on a lattice over region, filled one row at a time
+};
+
+class SceneGenerator final {
+public:
+	static constexpr int MAX_COUNT = 10000000;
+
+	scene_distribution distribution;
+	int count;
+	uint32_t seed;
+
+	aabb region;         //Where centers go
+	float fill;          //Radius, as a fraction of the average spacing between centers
+	int clusters;        //CLUSTERED only. 0 picks the cube root of count.
+	float clusterSpread; //CLUSTERED only. Standard deviation of each cluster, as a fraction of region's size.
+	int materials;       //Hues handed out at random. 0 leaves every sphere Sphere's red.
+
+	//Throws std::invalid_argument unless 0 < count <= MAX_COUNT. So do generate and write_to, if
+	//any setting has been changed to something out of range since.
+	SceneGenerator(const scene_distribution& distribution, const int& count, const uint32_t& seed = 1);
+
+	//Rebuilt, and ready to render. Its settings are Scene::DefaultSettings.
+	std::unique_ptr<Scene> generate(std::pmr::memory_resource* mem = std::pmr::get_default_resource()) const;
+
+	//The same scene, as a plain .gps file, written a block of spheres at a time. out must be
+	//opened with std::ios::binary. Throws std::invalid_argument if out isn't open, and
+	//std::runtime_error if it fails partway.
+	void write_to(std::ostream& out) const;
+
+private:
+	//Throws std::invalid_argument if any setting is out of range
+	void validate() const;
+
+	//Calls emit(center, radius, material) once per sphere, in order
+	template<typename F>
+	void forEach(F&& emit) const;
+
+	Color materialColor(const int& i) const;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	sphereset.hpp
+
+	Defines SphereSet, a batch of untransformed spheres stored as a
+	structure of arrays: centers and radii live in contiguous blocks of
+	ray_packet::WIDTH, so one ray is tested against a whole block at once
+	with no pointer chasing. Costs 16 bytes per sphere, against a Sphere's
+	heap allocation with its own transform and attrs.
+
+	Use Sphere for anything that needs a transform; use SphereSet for bulk.
+*/
+
+#include "raytrace.hpp"
+
+#include <vector>
+
+class SphereSet final : public Traceable {
+public:
+	//Color reported for every sphere in the set
+	Color color;
+
+	SphereSet();
+
+	//Adds one sphere. Radius must be positive.
+	void add(const Vector3& center, const float& radius);
+	void reserve(const int& count);
+	void clear();
+
+	inline int size() const { return _count; }
+	inline Vector3 GetCenter(const int& i) const { const block& b = _blocks[i / WIDTH]; return Vector3(b.cx[i % WIDTH], b.cy[i % WIDTH], b.cz[i % WIDTH]); }
+	inline float   GetRadius(const int& i) const { return _blocks[i / WIDTH].r[i % WIDTH]; }
+
+	using Traceable::trace;
+	virtual void trace(const Ray& ray, hit_buffer& out) override;
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) override;
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max) override;
+	virtual void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes) override;
+	virtual aabb bounds() const override;
+
+	//Normal of whichever sphere's surface pos is nearest to
+	virtual Vector3 normal_at(const Vector3& pos) override;
+
+private:
+	static constexpr int WIDTH = ray_packet::WIDTH;
+
+	//WIDTH spheres. Unused slots in the last block hold NaN, which every kernel treats as a miss.
+	//Each array is exactly one pfloat wide, so there's no padding between them.
+	struct block {
+		alignas(sizeof(float) * WIDTH) float cx[WIDTH];
+		alignas(sizeof(float) * WIDTH) float cy[WIDTH];
+		alignas(sizeof(float) * WIDTH) float cz[WIDTH];
+		alignas(sizeof(float) * WIDTH) float r [WIDTH];
+	};
+	static_assert(sizeof(block) == 16 * WIDTH, "SphereSet should cost 16 bytes per sphere");
+
+	std::vector<block> _blocks;
+	int _count;
+	aabb _bounds;
+
+	//Both roots of ray-sphere for every sphere in the block. Returns which lanes have real roots.
+	static pmask solve(const block& b, const Ray& ray, const float& a, pfloat& t0, pfloat& t1);
+
+	trace_hit makeHit(const Ray& ray, const int& index, const float& t) const;
+};
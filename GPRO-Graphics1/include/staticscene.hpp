@@ -0,0 +1,207 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	staticscene.hpp
+
+	Defines StaticScene, a scene that owns its objects by value. Each
+	type in Ts gets its own container, and a bvh_tree is built over all of
+	them. Primitives are referenced by (type, index) rather than by
+	pointer, so tracing one is a switch on the type followed by a direct,
+	inlinable call: no vtable, and no separate heap allocation per object.
+
+	Objects of any other Traceable type can still be added by pointer.
+	Those are called virtually, same as BVH does, and aren't owned.
+
+	StaticScene is itself Traceable, so Camera::render takes it as is:
+
+		StaticScene<Sphere, SphereSet> scene;
+		scene.add<Sphere>(Vector3(0, 0, 5), 1.0f);
+		scene.rebuild();
+		camera.render(scene);
+*/
+
+#include "raytrace.hpp"
+#include "bvh.hpp"
+
+#include <cfloat>
+#include <deque>
+#include <memory_resource>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+template<typename... Ts>
+class StaticScene final : public Traceable {
+private:
+	//Escape hatch. Forwards everything through the vtable.
+	struct indirect final {
+		Traceable* object;
+
+		inline void trace(const Ray& ray, hit_buffer& out) { object->trace(ray, out); }
+		inline bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) { return object->trace_closest(ray, t_min, t_max, out); }
+		inline bool trace_any(const Ray& ray, const float& t_min, const float& t_max) { return object->trace_any(ray, t_min, t_max); }
+		inline void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes) { object->trace_packet(rays, t_min, out, lanes); }
+		inline aabb bounds() const { return object->bounds(); }
+	};
+
+	//Position of T in Ts. indirect comes last.
+	template<typename T, typename... Us> struct type_index;
+	template<typename T, typename... Us> struct type_index<T, T, Us...> : std::integral_constant<int, 0> {};
+	template<typename T, typename U, typename... Us> struct type_index<T, U, Us...> : std::integral_constant<int, 1 + type_index<T, Us...>::value> {};
+
+	struct prim_ref final {
+		int type;  //Index into storage
+		int index; //Index into that container
+	};
+
+	//Deques, since they never move what's already in them. Sphere can't be moved at all.
+	std::tuple<std::pmr::deque<Ts>..., std::pmr::deque<indirect>> storage;
+
+	std::pmr::vector<prim_ref> prims; //Every object, in the order added
+	std::pmr::vector<prim_ref> order; //prims, reordered to match tree.indices, so each leaf is a contiguous run
+	bvh_tree tree;
+	int maxLeafSize;
+
+	//Calls f(object) with object's real type. Compiles down to a compare per type.
+	template<typename F>
+	inline void visit(const prim_ref& ref, F&& f) {
+		visitImpl(ref, f, std::make_index_sequence<sizeof...(Ts) + 1>());
+	}
+
+	template<typename F, size_t... Is>
+	inline void visitImpl(const prim_ref& ref, F& f, std::index_sequence<Is...>) {
+		(void)((ref.type == (int)Is && (f(std::get<Is>(storage)[ref.index]), true)) || ...);
+	}
+
+	template<typename T>
+	inline void track(const int& type) {
+		prims.push_back({ type, (int)std::get<type_index<T, Ts..., indirect>::value>(storage).size() - 1 });
+	}
+
+public:
+	//Objects and the tree over them all come from mem, which can be an Arena
+	explicit StaticScene(int maxLeafSize = bvh_tree::DEFAULT_LEAF_SIZE, std::pmr::memory_resource* mem = std::pmr::get_default_resource()) :
+		storage(std::pmr::deque<Ts>(mem)..., std::pmr::deque<indirect>(mem)),
+		prims(mem),
+		order(mem),
+		tree(mem),
+		maxLeafSize{ maxLeafSize }
+	{ }
+
+	//Not copyable: objects like Sphere hold pointers to themselves
+	StaticScene(const StaticScene&) = delete;
+	StaticScene& operator=(const StaticScene&) = delete;
+
+	//Constructs a T in place. Call rebuild() once everything is added.
+	template<typename T, typename... Args>
+	T& add(Args&&... args) {
+		constexpr int type = type_index<T, Ts..., indirect>::value;
+		T& obj = std::get<type>(storage).emplace_back(std::forward<Args>(args)...);
+		track<T>(type);
+		return obj;
+	}
+
+	//Escape hatch for types not in Ts. Not owned, and called virtually.
+	void add(Traceable* object) {
+		if (object == nullptr) throw std::invalid_argument("Can't add a null object");
+		constexpr int type = sizeof...(Ts);
+		std::get<type>(storage).push_back({ object });
+		track<indirect>(type);
+	}
+
+	//Every object of type T, in the order added
+	template<typename T>
+	inline std::pmr::deque<T>& get() { return std::get<type_index<T, Ts..., indirect>::value>(storage); }
+
+	inline size_t size() const { return prims.size(); }
+
+	//Must be called after adding or moving objects, before tracing
+	void rebuild() {
+		std::pmr::vector<aabb> primitiveBounds(tree.GetResource());
+		primitiveBounds.reserve(prims.size());
+		for (const prim_ref& ref : prims) visit(ref, [&](auto& obj) {
+			using T = std::decay_t<decltype(obj)>;
+			primitiveBounds.push_back(obj.T::bounds());
+		});
+		tree.build(primitiveBounds, maxLeafSize);
+
+		order.resize(tree.indices.size());
+		for (size_t i = 0; i < order.size(); i++) order[i] = prims[tree.indices[i]];
+	}
+
+	//Same queries, in the same order, as BVH. Calls are qualified so they bind statically
+	//even for types that aren't final.
+
+	using Traceable::trace;
+	virtual void trace(const Ray& ray, hit_buffer& out) override {
+		tree.traverse(ray, 0, FLT_MAX, [&](const bvh_node& leaf) {
+			for (int i = leaf.first; i < leaf.first + leaf.count; i++) visit(order[i], [&](auto& obj) {
+				using T = std::decay_t<decltype(obj)>;
+				obj.T::trace(ray, out);
+			});
+			return false;
+		});
+	}
+
+	virtual bool trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out) override {
+		bool found = false;
+		float closest = t_max;
+		tree.traverse(ray, t_min, closest, [&](const bvh_node& leaf) {
+			for (int i = leaf.first; i < leaf.first + leaf.count; i++) visit(order[i], [&](auto& obj) {
+				using T = std::decay_t<decltype(obj)>;
+				if (obj.T::trace_closest(ray, t_min, closest, out)) {
+					closest = out.t;
+					found = true;
+				}
+			});
+			return false;
+		});
+		return found;
+	}
+
+	virtual bool trace_any(const Ray& ray, const float& t_min, const float& t_max) override {
+		bool found = false;
+		tree.traverse(ray, t_min, t_max, [&](const bvh_node& leaf) {
+			for (int i = leaf.first; i < leaf.first + leaf.count && !found; i++) visit(order[i], [&](auto& obj) {
+				using T = std::decay_t<decltype(obj)>;
+				found = obj.T::trace_any(ray, t_min, t_max);
+			});
+			return found;
+		});
+		return found;
+	}
+
+	virtual void trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes) override {
+		tree.traverse(rays, t_min, out.t_max, lanes, [&](const bvh_node& leaf, const int& active) {
+			for (int i = leaf.first; i < leaf.first + leaf.count; i++) visit(order[i], [&](auto& obj) {
+				using T = std::decay_t<decltype(obj)>;
+				obj.T::trace_packet(rays, t_min, out, active);
+			});
+		});
+	}
+
+	virtual aabb bounds() const override { return tree.GetBounds(); }
+
+	//A scene has no surface of its own. Use trace_hit::normal instead.
+	virtual Vector3 normal_at(const Vector3& /*pos*/) override {
+		throw std::logic_error("StaticScene has no surface of its own; use trace_hit::normal instead");
+	}
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	threadpool.hpp
+
+	Defines the ThreadPool class, a small work-stealing scheduler. Every
+	worker owns a queue of tasks: it pops from the back of its own queue,
+	and when that runs dry it steals from the front of someone else's.
+	Used by Camera to render tiles in parallel.
+
+	A task is a function pointer and an index into whatever it works on,
+	not a std::function, and queues are fixed-size rings that only grow
+	when they fill up. Once reserve() has made room, submitting and
+	running tasks never touches the heap.
+*/
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+class ThreadPool final {
+public:
+	//Calls run(context, index)
+	struct task_t final {
+		void (*run)(void* context, int index);
+		void* context;
+		int index;
+	};
+
+	//0 threads = one per hardware core
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	//Pools own threads, so they can't be copied
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	inline unsigned int size() const { return (unsigned int)queues.size(); } //Not workers: those are still being started when the first ones run
+
+	//Make room for this many tasks waiting at once, so submitting them never allocates.
+	//Only allocates if there isn't room already.
+	void reserve(int tasks);
+
+	//Queue a task. Tasks are dealt round-robin, then balanced by stealing.
+	void submit(const task_t& task);
+
+	//Queue a call to f(index). f is held by reference, so it must outlive the task:
+	//usually it's a lambda declared before the submits, and wait() comes before it goes.
+	template<typename F>
+	inline void submit(const F& f, int index) {
+		submit(task_t{ [](void* context, int i) { (*(const F*)context)(i); }, (void*)&f, index });
+	}
+
+	//Block until every submitted task has finished
+	void wait();
+
+	//Resolves 0 to the number of hardware threads (minimum 1)
+	static unsigned int resolveThreadCount(unsigned int threadCount);
+
+private:
+	//Ring buffer of tasks, oldest at first
+	struct worker_queue final {
+		std::mutex lock;
+		std::vector<task_t> tasks;
+		size_t first = 0;
+		size_t count = 0;
+
+		//Both under lock
+		void grow(size_t capacity);
+		inline task_t& at(size_t i) { return tasks[(first + i) % tasks.size()]; }
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<worker_queue>> queues;
+
+	std::mutex sleepLock;
+	std::condition_variable wakeWorkers; //Signalled when tasks are submitted or we're shutting down
+	std::condition_variable tasksDone;   //Signalled when pending hits 0
+
+	std::atomic<unsigned int> nextQueue; //Round-robin cursor for submit()
+	std::atomic<int> queued;             //Tasks sitting in a queue, not yet picked up
+	std::atomic<int> pending;            //Tasks submitted but not yet finished
+	bool stopping;
+
+	bool tryPop(unsigned int self, task_t& out);
+	void workerMain(unsigned int self);
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	transform.hpp
+
+	Defines the Transform class, which keeps an object's local-to-world
+	matrix together with everything derived from it: world-to-local, and
+	the normal matrix (inverse transpose). Derived matrices are recomputed
+	once per change instead of once per ray, and every change bumps a
+	version counter so anything caching data off a Transform (bounds, for
+	example) can tell when it's gone stale.
+*/
+
+#include "mat4.hpp"
+
+class Transform final {
+private:
+	mat4 _ltw;
+	mat4 _wtl;
+	mat4 _normal; //Transpose of _wtl. Only the upper 3x3 is meaningful.
+	unsigned int _version;
+
+public:
+	//Identity
+	Transform();
+	explicit Transform(const mat4& localToWorld);
+
+	inline const mat4& GetLocalToWorld () const { return _ltw; }
+	inline const mat4& GetWorldToLocal () const { return _wtl; }
+	inline const mat4& GetNormalToWorld() const { return _normal; }
+
+	//Both of these recompute every derived matrix, so call them sparingly
+	void SetLocalToWorld(const mat4& value);
+	void SetWorldToLocal(const mat4& value);
+
+	//Changes every time the transform does
+	inline unsigned int GetVersion() const { return _version; }
+
+	//Local-space normal to world-space normal, normalized
+	inline Vector3 TransformNormal(const Vector3& normal) const { return _normal.TransformVector(normal).Normalize(); }
+};
@@ -30,14 +30,19 @@
 
 #include "rawdata.hpp"
 
+#include <cmath>
+
 //Fancy interface sitting on top of a float3.
 //Provides vector math utility functions.
 struct Vector3 final : public float3 {
 public:
-	float &x, &y, &z;
+	//Named views of float3's storage. Costs nothing: a Vector3 is still just 3 floats.
+	using float3::x;
+	using float3::y;
+	using float3::z;
 
 	//Main constructor that should be used wherever possible.
-	Vector3(const float& _x, const float& _y, const float& _z);
+	inline Vector3(const float& _x, const float& _y, const float& _z) : float3(_x, _y, _z) {}
 	
 	//Quick-reference shortcuts
 	inline static const Vector3    zero() { return Vector3(0, 0, 0); }
@@ -55,23 +60,69 @@ public:
 
 	//Cast conversion. Allows float3's operators to still work, including the mildly dangerous *=
 	//Also allows unsafe, unchecked conversions between Color and Vector3.
-	Vector3(const float3& base);
+	inline Vector3(const float3& base) : float3(base) {}
 	
-	//Copy constructor, because C++ implicitly deletes it otherwise.
-	inline Vector3(const Vector3& cpy) : Vector3((const float3&)cpy) {}
+	//Trivial, so Vector3 can be memcpy'd
+	Vector3(const Vector3& cpy) = default;
 
 	//Make it behave like Unity's Vector3's operator=
-	Vector3 operator=(const float3& rhs);
-	Vector3 operator=(const Vector3& rhs);
+	inline Vector3& operator=(const float3& rhs) { float3::operator=(rhs); return *this; }
+	Vector3& operator=(const Vector3& rhs) = default;
 
 	//Pythagorean
-	float GetMagnitude() const;
+	inline float GetMagnitude() const;
 	Vector3 WithMagnitude(const float& m) const;
 	Vector3 WithBoundedMagnitude(const float& min, const float& max) const;
-	Vector3 Normalize() const;
+	inline Vector3 Normalize() const;
 
 	//Trigonometry
-	float Dot(const Vector3& other) const;
-	Vector3 Cross(const Vector3& other) const;
+	inline float Dot(const Vector3& other) const;
+	inline Vector3 Cross(const Vector3& other) const;
 	float Angle(const Vector3& other) const;
-};
\ No newline at end of file
+};
+
+static_assert(sizeof(Vector3) == sizeof(float3), "Vector3 must not add anything to float3's storage");
+static_assert(std::is_trivially_copyable<Vector3>::value, "Vector3 must be trivially copyable");
+
+//Called per ray and per hit, so these are inline. See rawdata.hpp for GPRO_SIMD_SSE.
+
+inline float Vector3::Dot(const Vector3& other) const
+{
+#ifdef GPRO_SIMD_SSE
+	//Summed as (x+y)+z, same as the scalar path
+	__m128 m = _mm_mul_ps(_load(), other._load());
+	__m128 xy = _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(_mm_add_ss(xy, _mm_movehl_ps(m, m)));
+#else
+	return x*other.x + y*other.y + z*other.z;
+#endif
+}
+
+inline Vector3 Vector3::Cross(const Vector3& other) const
+{
+#ifdef GPRO_SIMD_SSE
+	//yzx*zxy - zxy*yzx
+	__m128 a = _load(), b = other._load();
+	__m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 a_zxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+	__m128 b_zxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+	return Vector3(_store(_mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx))));
+#else
+	return Vector3(
+		this->y*other.z - this->z*other.y,
+		this->z*other.x - this->x*other.z,
+		this->x*other.y - this->y*other.x
+	);
+#endif
+}
+
+inline float Vector3::GetMagnitude() const
+{
+	return sqrtf(Dot(*this));
+}
+
+inline Vector3 Vector3::Normalize() const
+{
+	return (*this) / GetMagnitude();
+}
\ No newline at end of file
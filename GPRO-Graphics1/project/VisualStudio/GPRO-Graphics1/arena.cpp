@@ -0,0 +1,83 @@
+#include "arena.hpp"
+
+#include <cstdint>
+
+static constexpr size_t CHUNK_ALIGNMENT = alignof(std::max_align_t);
+
+Arena::Arena(const size_t& capacity, std::pmr::memory_resource* upstream) :
+	upstream{ upstream },
+	block{ capacity > 0 ? (unsigned char*)upstream->allocate(capacity, CHUNK_ALIGNMENT) : nullptr },
+	blockSize{ capacity },
+	chunks{ nullptr },
+	spilledBytes{ 0 },
+	cur{ block },
+	end{ block + capacity }
+{ }
+
+Arena::~Arena()
+{
+	reset();
+	if (block != nullptr) upstream->deallocate(block, blockSize, CHUNK_ALIGNMENT);
+}
+
+void Arena::reset()
+{
+	const size_t grow = spilledBytes;
+
+	while (chunks != nullptr) {
+		chunk_header* next = chunks->next;
+		upstream->deallocate(chunks, chunks->size, CHUNK_ALIGNMENT);
+		chunks = next;
+	}
+	spilledBytes = 0;
+
+	//Make room for everything that spilled, so next time it all fits
+	if (grow > 0) {
+		if (block != nullptr) upstream->deallocate(block, blockSize, CHUNK_ALIGNMENT);
+		blockSize += grow;
+		block = (unsigned char*)upstream->allocate(blockSize, CHUNK_ALIGNMENT);
+	}
+
+	cur = block;
+	end = block + blockSize;
+}
+
+void* Arena::bump(const size_t& bytes, const size_t& alignment)
+{
+	if (cur == nullptr) return nullptr;
+
+	const uintptr_t start = ((uintptr_t)cur + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+	if (start + bytes > (uintptr_t)end) return nullptr;
+
+	cur = (unsigned char*)(start + bytes);
+	return (void*)start;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment)
+{
+	if (void* p = bump(bytes, alignment)) return p;
+
+	//Doesn't fit. Start a new chunk, at least as big as the block so spills stay rare.
+	size_t size = sizeof(chunk_header) + bytes + alignment;
+	if (size < blockSize) size = blockSize;
+
+	chunk_header* chunk = (chunk_header*)upstream->allocate(size, CHUNK_ALIGNMENT);
+	chunk->next = chunks;
+	chunk->size = size;
+	chunks = chunk;
+	spilledBytes += size;
+
+	cur = (unsigned char*)(chunk + 1);
+	end = (unsigned char*)chunk + size;
+	return bump(bytes, alignment);
+}
+
+void Arena::do_deallocate(void* /*p*/, size_t /*bytes*/, size_t /*alignment*/)
+{
+	//Nothing to do. Memory comes back all at once in reset().
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
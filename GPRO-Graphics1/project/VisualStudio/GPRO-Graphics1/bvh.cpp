@@ -0,0 +1,185 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#pragma region bvh_tree
+
+void bvh_tree::build(const std::pmr::vector<aabb>& primitiveBounds, int maxLeafSize)
+{
+	const int count = (int)primitiveBounds.size();
+
+	nodes.clear();
+	indices.resize(count);
+	std::iota(indices.begin(), indices.end(), 0);
+	if (count == 0) return;
+
+	//Flat xyz triples. Splitting sorts by these over and over, so keep them cheap to read.
+	std::pmr::vector<float> centroids(3 * (size_t)count, GetResource());
+	for (int i = 0; i < count; i++) {
+		Vector3 c = primitiveBounds[i].GetCenter();
+		centroids[3*i+0] = c.x;
+		centroids[3*i+1] = c.y;
+		centroids[3*i+2] = c.z;
+	}
+
+	nodes.reserve(2 * (size_t)count); //A binary tree with n leaves has at most 2n-1 nodes
+	nodes.push_back(bvh_node());
+	buildNode(0, 0, count, primitiveBounds, centroids, std::max(maxLeafSize, 1), 1);
+}
+
+void bvh_tree::buildNode(int nodeIndex, int first, int count, const std::pmr::vector<aabb>& primitiveBounds, const std::pmr::vector<float>& centroids, int maxLeafSize, int depth)
+{
+	aabb box;
+	aabb centroidBox;
+	for (int i = first; i < first + count; i++) {
+		const int prim = indices[i];
+		box.Expand(primitiveBounds[prim]);
+		centroidBox.Expand(Vector3(centroids[3*prim+0], centroids[3*prim+1], centroids[3*prim+2]));
+	}
+	nodes[nodeIndex].box = box;
+
+	//Stop if small enough, or if every centroid is in the same spot (nothing to split on)
+	const int axis = centroidBox.GetLongestAxis();
+	const Vector3 spread = centroidBox.GetSize();
+	const float axisSpread = axis == 0 ? spread.x : (axis == 1 ? spread.y : spread.z);
+	if (count <= maxLeafSize || axisSpread <= 0 || depth >= MAX_DEPTH - 1) {
+		nodes[nodeIndex].first = first;
+		nodes[nodeIndex].count = count;
+		return;
+	}
+
+	//Median split. Guarantees log2(n) depth regardless of how primitives are distributed.
+	const int half = count / 2;
+	std::nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count,
+		[&centroids, axis](int a, int b) { return centroids[3*a+axis] < centroids[3*b+axis]; });
+
+	//Children are allocated as a pair, so the right child is always left+1
+	const int left = (int)nodes.size();
+	nodes.push_back(bvh_node());
+	nodes.push_back(bvh_node());
+	nodes[nodeIndex].first = left;
+	nodes[nodeIndex].count = 0;
+
+	buildNode(left    , first       , half        , primitiveBounds, centroids, maxLeafSize, depth + 1);
+	buildNode(left + 1, first + half, count - half, primitiveBounds, centroids, maxLeafSize, depth + 1);
+}
+
+void bvh_tree::assign(std::pmr::vector<bvh_node>&& nodes, const int& primitiveCount)
+{
+	const int nodeCount = (int)nodes.size();
+	if (primitiveCount < 0 || (nodeCount == 0) != (primitiveCount == 0)) throw std::invalid_argument("Node and primitive counts don't match!");
+
+	//Everything traverse relies on: children come after their parent (so there are no cycles),
+	//leaves stay inside the primitives, and nothing is deeper than the traversal stack
+	struct entry { int node, depth; };
+	std::pmr::vector<entry> stack(GetResource());
+	if (nodeCount > 0) stack.push_back({ 0, 1 });
+	int visited = 0;
+	while (!stack.empty()) {
+		const entry cur = stack.back();
+		stack.pop_back();
+		const bvh_node& node = nodes[cur.node];
+		if (++visited > nodeCount) throw std::invalid_argument("Tree has shared nodes!");
+
+		if (node.IsLeaf()) {
+			if (node.first < 0 || node.first > primitiveCount - node.count) throw std::invalid_argument("Leaf out of bounds!");
+		}
+		else {
+			if (node.count != 0 || node.first <= cur.node || node.first >= nodeCount - 1) throw std::invalid_argument("Child out of bounds!");
+			if (cur.depth >= MAX_DEPTH - 1) throw std::invalid_argument("Tree too deep!");
+			stack.push_back({ node.first + 1, cur.depth + 1 });
+			stack.push_back({ node.first    , cur.depth + 1 });
+		}
+	}
+	if (visited != nodeCount) throw std::invalid_argument("Tree has unreachable nodes!");
+
+	this->nodes = std::move(nodes);
+	indices.resize(primitiveCount);
+	std::iota(indices.begin(), indices.end(), 0);
+}
+
+#pragma endregion bvh_tree
+
+#pragma region BVH
+
+BVH::BVH(const std::vector<Traceable*>& objects, int maxLeafSize, std::pmr::memory_resource* mem) :
+	objects(objects.begin(), objects.end(), mem),
+	tree(mem),
+	maxLeafSize{ maxLeafSize }
+{
+	rebuild();
+}
+
+void BVH::rebuild()
+{
+	std::pmr::vector<aabb> primitiveBounds(tree.GetResource());
+	primitiveBounds.reserve(objects.size());
+	for (Traceable* obj : objects) primitiveBounds.push_back(obj->bounds());
+	tree.build(primitiveBounds, maxLeafSize);
+}
+
+void BVH::trace(const Ray& ray, hit_buffer& out)
+{
+	tree.traverse(ray, 0, FLT_MAX, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) objects[tree.indices[i]]->trace(ray, out);
+		return false;
+	});
+}
+
+bool BVH::trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out)
+{
+	//Every hit shrinks the search range, so boxes behind it get culled by traverse()
+	bool found = false;
+	float closest = t_max;
+
+	tree.traverse(ray, t_min, closest, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			if (objects[tree.indices[i]]->trace_closest(ray, t_min, closest, out)) {
+				closest = out.t;
+				found = true;
+			}
+		}
+		return false;
+	});
+
+	return found;
+}
+
+bool BVH::trace_any(const Ray& ray, const float& t_min, const float& t_max)
+{
+	bool found = false;
+
+	tree.traverse(ray, t_min, t_max, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			if (objects[tree.indices[i]]->trace_any(ray, t_min, t_max)) return found = true;
+		}
+		return false;
+	});
+
+	return found;
+}
+
+void BVH::trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes)
+{
+	//Same as trace_closest, but every lane shrinks its own range
+	tree.traverse(rays, t_min, out.t_max, lanes, [&](const bvh_node& leaf, const int& active) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			objects[tree.indices[i]]->trace_packet(rays, t_min, out, active);
+		}
+	});
+}
+
+aabb BVH::bounds() const
+{
+	return tree.GetBounds();
+}
+
+Vector3 BVH::normal_at(const Vector3& /*pos*/)
+{
+	throw std::logic_error("BVH has no surface of its own; use trace_hit::normal instead");
+}
+
+#pragma endregion BVH
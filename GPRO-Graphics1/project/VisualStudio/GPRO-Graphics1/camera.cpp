@@ -1,23 +1,108 @@
 #include "camera.hpp"
 
 #include <cmath>
+#include <cfloat>
 #include "moremath.inl"
 
+#include "threadpool.hpp"
+#include "bvh.hpp"
+#include "grid.hpp"
+
 #include <vector>
+#include <mutex>
+#include <algorithm> /* min */
 #include <iostream>
 #include <iomanip> /* setprecision */
+#include <memory>
+#include <new> /* placement new */
+#include <stdexcept>
+
+#pragma region ray_table
+
+ray_table::ray_table(const int& width, const int& height, const float& fov) :
+	width{ width },
+	height{ height },
+	fov{ fov },
+	tanX(width),
+	tanY(height)
+{
+	//Same expressions as Camera::prepareTracer, so rays match it bit for bit
+	const float asp_ratio = float(width)/height;
+	for (int x = 0; x < width ; x++) tanX[x] = tanf(fmap((float)x, 0.0f, (float)width , -fov/2, fov/2));
+	for (int y = 0; y < height; y++) tanY[y] = tanf(fmap((float)y, 0.0f, (float)height, -fov/2, fov/2)*asp_ratio);
+}
+
+void ray_table::GetRow(const int& y, const int& x0, const int& x1, float* dx, float* dy, float* dz) const
+{
+	std::copy(tanX.begin() + x0, tanX.begin() + x1, dx);
+	std::fill(dy, dy + (x1 - x0), tanY[y]);
+	std::fill(dz, dz + (x1 - x0), 1.0f);
+}
+
+void ray_table::GetTile(const int& x0, const int& y0, const int& x1, const int& y1, float* dx, float* dy, float* dz) const
+{
+	const int w = x1 - x0;
+	for (int y = y0; y < y1; y++) {
+		const int offset = (y - y0) * w;
+		GetRow(y, x0, x1, dx + offset, dy + offset, dz + offset);
+	}
+}
+
+void ray_table::GetPacket(const int& y, const int& x, const int& x1, ray_packet& out) const
+{
+	for (int i = 0; i < ray_packet::WIDTH; i++) {
+		const int px = std::min(x + i, x1 - 1);
+		out.ox[i] = 0;
+		out.oy[i] = 0;
+		out.oz[i] = 0;
+		out.dx[i] = tanX[px];
+		out.dy[i] = tanY[y];
+		out.dz[i] = 1;
+	}
+}
+
+#pragma endregion ray_table
 
 Camera::Camera(Image& viewport, const float& fov) :
 	viewport{ &viewport },
-	fov{ fov }
+	fov{ fov },
+	threadCount{ 0 },
+	tileSize{ 16 },
+	usePackets{ true },
+	accelerator{ scene_accelerator::AUTO },
+	arena{ nullptr }
+{ }
+
+Camera::Camera(const float& fov) :
+	viewport{ nullptr },
+	fov{ fov },
+	threadCount{ 0 },
+	tileSize{ 16 },
+	usePackets{ true },
+	accelerator{ scene_accelerator::AUTO },
+	arena{ nullptr }
 { }
 
-inline Ray Camera::prepareTracer(const int& px_x, const int& px_y) const
+Camera::~Camera() = default; //Here, where ThreadPool is complete
+
+ThreadPool& Camera::getPool() const
+{
+	const unsigned int threads = ThreadPool::resolveThreadCount(threadCount);
+	if (!pool || pool->size() != threads) pool.reset(new ThreadPool(threads));
+	return *pool;
+}
+
+Ray Camera::prepareTracer(const int& px_x, const int& px_y) const
+{
+	return prepareTracer(px_x, px_y, viewport->width, viewport->height);
+}
+
+Ray Camera::prepareTracer(const int& px_x, const int& px_y, const int& width, const int& height) const
 {
-	const float asp_ratio = float(viewport->width)/viewport->height;
+	const float asp_ratio = float(width)/height;
 	
-	float ang_x = fmap((float)px_x, 0.0f, (float)viewport->width , -fov/2, fov/2);
-	float ang_y = fmap((float)px_y, 0.0f, (float)viewport->height, -fov/2, fov/2)*asp_ratio;
+	float ang_x = fmap((float)px_x, 0.0f, (float)width , -fov/2, fov/2);
+	float ang_y = fmap((float)px_y, 0.0f, (float)height, -fov/2, fov/2)*asp_ratio;
 	
 	float glob_x = tanf(ang_x);
 	float glob_y = tanf(ang_y);
@@ -28,49 +113,207 @@ inline Ray Camera::prepareTracer(const int& px_x, const int& px_y) const
 	);
 }
 
-void Camera::render(std::vector<Traceable*> objects) const
+std::shared_ptr<const ray_table> Camera::getRayTable(const int& width, const int& height) const
+{
+	std::shared_ptr<const ray_table> rays = std::atomic_load(&rayCache);
+	if (!rays || !rays->Matches(width, height, fov)) {
+		//Racing threads might each build one, but they'd all be identical
+		rays = std::make_shared<const ray_table>(width, height, fov);
+		std::atomic_store(&rayCache, rays);
+	}
+	return rays;
+}
+
+Arena& Camera::beginFrame(std::unique_ptr<Arena>& fallback) const
+{
+	if (arena != nullptr) {
+		arena->reset();
+		return *arena;
+	}
+	fallback.reset(new Arena());
+	return *fallback;
+}
+
+//buildScene's result lives in the frame's Arena, which frees the memory itself
+struct scene_deleter final {
+	inline void operator()(Traceable* scene) const { scene->~Traceable(); }
+};
+
+Traceable* Camera::buildScene(const std::vector<Traceable*>& objects, Arena& frame) const
+{
+	bool grid = accelerator == scene_accelerator::GRID;
+	if (accelerator == scene_accelerator::AUTO) {
+		std::pmr::vector<aabb> primitiveBounds(&frame);
+		primitiveBounds.reserve(objects.size());
+		for (Traceable* obj : objects) primitiveBounds.push_back(obj->bounds());
+		grid = uniform_grid::Suits(primitiveBounds);
+	}
+
+	if (grid) {
+		void* memory = frame.allocate(sizeof(UniformGrid), alignof(UniformGrid));
+		if (ThreadPool::resolveThreadCount(threadCount) == 1) return new (memory) UniformGrid(objects, uniform_grid::DEFAULT_DENSITY, 1, &frame);
+		return new (memory) UniformGrid(objects, getPool(), uniform_grid::DEFAULT_DENSITY, &frame); //On the render threads, rather than starting more
+	}
+	else return new (frame.allocate(sizeof(BVH), alignof(BVH))) BVH(objects, bvh_tree::DEFAULT_LEAF_SIZE, &frame);
+}
+
+void Camera::render(const std::vector<Traceable*>& objects) const
+{
+	std::unique_ptr<Arena> fallback;
+	Arena& frame = beginFrame(fallback);
+
+	std::unique_ptr<Traceable, scene_deleter> scene(buildScene(objects, frame));
+	renderImage(*scene, frame);
+}
+
+void Camera::render(Traceable& scene) const
+{
+	std::unique_ptr<Arena> fallback;
+	renderImage(scene, beginFrame(fallback));
+}
+
+void Camera::renderImage(Traceable& scene, Arena& frame) const
 {
-	std::vector<trace_hit> all_hits; //Reset between traces
+	if (viewport == nullptr) throw std::logic_error("Camera has no viewport to render into");
+
+	const std::shared_ptr<const ray_table> rays = getRayTable(viewport->width, viewport->height);
+	if (ThreadPool::resolveThreadCount(threadCount) == 1) renderSerial(*rays, scene, frame);
+	else renderParallel(*rays, scene, frame);
+}
+
+void Camera::render(const std::vector<Traceable*>& objects, ScanlineWriter& out) const
+{
+	std::unique_ptr<Arena> fallback;
+	Arena& frame = beginFrame(fallback);
+
+	std::unique_ptr<Traceable, scene_deleter> scene(buildScene(objects, frame));
+	render(*scene, out);
+}
+
+void Camera::render(Traceable& scene, ScanlineWriter& out) const
+{
+	const int width = out.width, height = out.height;
+	const std::shared_ptr<const ray_table> rays = getRayTable(width, height);
+	const bool serial = ThreadPool::resolveThreadCount(threadCount) == 1;
+
+	//Whole rows are the unit of work here, since that's what the writer consumes. Rows are
+	//only acquired from this thread, so workers never block on the writer and can't deadlock it.
+	ThreadPool* pool = serial ? nullptr : &getPool();
+
+	//Where each slot of the writer's window was acquired. Slot y % windowRows isn't
+	//acquired again until row y has been written, so a task can read its row's entry.
+	std::vector<Color*> acquired(out.windowRows);
+	const auto traceTask = [&](int y) {
+		traceRow(*rays, y, 0, width, scene, acquired[y % out.windowRows]);
+		out.submit(y);
+	};
+	if (pool != nullptr) pool->reserve(out.windowRows);
+
+	for (int y = 0; y < height; y++) {
+		//Show a progress bar of sorts
+		std::cout << std::setprecision(2) << y/float(height)*100 << "% ... ";
+
+		acquired[y % out.windowRows] = out.acquire(y);
+		if (serial) traceTask(y);
+		else pool->submit(traceTask, y);
+	}
+
+	if (pool != nullptr) pool->wait();
+	out.finish();
+}
+
+Color Camera::tracePixel(const ray_table& rays, const int& x, const int& y, Traceable& scene) const
+{
+	Ray ray = rays.GetRay(x, y);
+
+	//Only the nearest hit in front of the camera matters (occlusion)
+	trace_hit closest;
+	if (scene.trace_closest(ray, 0, FLT_MAX, closest)) {
+		return closest.color;
+	}
+	else {
+		//Ray hit nothing, fill with sky
+		return skyColor(y, rays.height);
+	}
+}
+
+void Camera::traceRow(const ray_table& rays, const int& y, const int& x0, const int& x1, Traceable& scene, Color* out) const
+{
+	if (!usePackets) {
+		for (int x = x0; x < x1; x++) out[x - x0] = tracePixel(rays, x, y, scene);
+		return;
+	}
+
+	const Color sky = skyColor(y, rays.height);
+	ray_packet packet;
+	for (int x = x0; x < x1; x += ray_packet::WIDTH) {
+		//Spare lanes at the end of the row repeat the last pixel's ray and are masked off
+		const int used = std::min(ray_packet::WIDTH, x1 - x);
+		rays.GetPacket(y, x, x1, packet);
+
+		packet_hit closest(FLT_MAX);
+		scene.trace_packet(packet, 0, closest, (1 << used) - 1);
+
+		for (int i = 0; i < used; i++) {
+			out[x - x0 + i] = ((closest.mask >> i) & 1) ? closest.hits[i].color : sky;
+		}
+	}
+}
+
+Color Camera::skyColor(const int& y, const int& height) const
+{
+	return Color::FromRGB(0, fmap(float(y), 0, float(height), 0, 1), 1);
+}
+
+void Camera::renderSerial(const ray_table& rays, Traceable& scene, Arena& frame) const
+{
+	//Traced at full precision, then converted into the viewport's format a row at a time
+	std::pmr::vector<Color> row(viewport->width, &frame);
+
 	for (int y = 0; y < viewport->height; y++) {
 		//Show a progress bar of sorts
 		std::cout << std::setprecision(2) << y/float(viewport->height)*100 << "% ... ";
 
-		for (int x = 0; x < viewport->width; x++) {
-			Ray ray = prepareTracer(x, y);
-
-			/*
-			//Trace for all objects
-			for (int i = 0; i < objects.size(); i++) {
-				std::vector<trace_hit> cur_hits = objects[i]->trace(ray);
-				//Copy all trace points into all_hits
-				for (int j = 0; j < cur_hits.size(); j++) all_hits.push_back(cur_hits[i]);
-			}
-			*/
-			all_hits = objects[0]->trace(ray);
-			
-			//*
-			if (all_hits.size() > 0) {
-				trace_hit* closest = &all_hits[0];
-
-				//Sort and find the trace_hit closest to the camera (occlusion)
-				for (int i = 1; i < all_hits.size(); i++) {
-					if (all_hits[i].position.GetMagnitude() < closest->position.GetMagnitude()) closest = &all_hits[i];
-				}
-
-				viewport->pixel_at(x, y) = closest->color;
-			}
-			else {
-				//Ray hit nothing, fill with sky
-				Color sky = Color::FromRGB(0, fmap(float(y), 0, float(viewport->height), 0, 1), 1);
-				viewport->pixel_at(x, y) = sky;
-			}
-			// */
-
-			//if (all_hits.size() == 2) viewport->pixel_at(x, y) = Color::FromRGB(  0,   0, 255, 255);
-			//if (all_hits.size() == 1) viewport->pixel_at(x, y) = Color::FromRGB(  0, 255,   0, 255);
-			//if (all_hits.size() == 0) viewport->pixel_at(x, y) = Color::FromRGB(255,   0,   0, 255);
-
-			all_hits.clear();
-		}
+		traceRow(rays, y, 0, viewport->width, scene, row.data());
+		viewport->set_pixels(0, y, row.data(), viewport->width);
 	}
 }
+
+void Camera::renderParallel(const ray_table& rays, Traceable& scene, Arena& frame) const
+{
+	const int tile = tileSize > 0 ? tileSize : 16;
+	const int tilesX = (viewport->width  + tile - 1) / tile;
+	const int tilesY = (viewport->height + tile - 1) / tile;
+	const int tileCount = tilesX * tilesY;
+
+	//Every pixel is written by exactly one tile, and tracePixel only reads
+	//shared state, so tiles need no synchronization beyond the progress bar.
+	std::mutex progressLock;
+	int tilesDone = 0;
+
+	//One row buffer per tile, all allocated up front, so workers never allocate
+	std::pmr::vector<Color> rows((size_t)tileCount * tile, &frame);
+
+	//Tasks are just a tile index, and this, by reference. The pool's queues keep their
+	//size between frames, so after the first frame, handing out tiles doesn't allocate either.
+	const auto renderTile = [&](int t) {
+		const int tx = t % tilesX, ty = t / tilesX;
+		Color* row = rows.data() + (size_t)t * tile;
+		const int x1 = std::min(tx*tile + tile, viewport->width );
+		const int y1 = std::min(ty*tile + tile, viewport->height);
+		for (int y = ty*tile; y < y1; y++) {
+			traceRow(rays, y, tx*tile, x1, scene, row);
+			viewport->set_pixels(tx*tile, y, row, x1 - tx*tile);
+		}
+
+		//Show a progress bar of sorts
+		std::lock_guard<std::mutex> guard(progressLock);
+		std::cout << std::setprecision(2) << tilesDone/float(tileCount)*100 << "% ... ";
+		tilesDone++;
+	};
+
+	ThreadPool& pool = getPool();
+	pool.reserve(tileCount);
+	for (int t = 0; t < tileCount; t++) pool.submit(renderTile, t);
+	pool.wait();
+}
@@ -136,11 +136,6 @@ float Color::GetValue() const
 	return most;
 }
 
-float Color::GetScale() const
-{
-	return _scale;
-}
-
 inline void Color::SetScale(float newScale)
 {
 	_scale = newScale;
@@ -152,32 +147,18 @@ Color Color::RemapScale(float newScale)
 	return Color(r*rescaleFactor, g*rescaleFactor, b*rescaleFactor, newScale); //Stack-allocated. TODO Is this OK?
 }
 
-Color& Color::operator=(const float3& _rhs)
-{
-	//UNSAFE! But gives us access to internal values. Just don't try any
-	//function calls, there's no telling what will happen.
-	const Color* const rhs = reinterpret_cast<const Color* const>(&_rhs);
-
-	this->val0 = rhs->val0;
-	this->val1 = rhs->val1;
-	this->val2 = rhs->val2;
-	return *this;
-}
-
-Color& Color::operator=(const Color& rhs)
+Color& Color::operator=(const float3& rhs)
 {
-	this->val0 = rhs.val0;
-	this->val1 = rhs.val1;
-	this->val2 = rhs.val2;
+	float3::operator=(rhs);
 	return *this;
 }
 
 
-Color::Color(const float3& base) : float3(base), r{ val0 }, g{ val1 }, b{ val2 }, _scale{ 1.0 }
+Color::Color(const float3& base) : float3(base), _scale{ 1.0 }
 { }
 
 Color::Color() : Color(0, 0, 0, 1)
 { }
 
-Color::Color(const float& _r, const float &_g, const float& _b, const float& _scale) : float3(_r, _g, _b), r{ val0 }, g{ val1 }, b{ val2 }, _scale{ _scale }
+Color::Color(const float& _r, const float &_g, const float& _b, const float& _scale) : float3(_r, _g, _b), _scale{ _scale }
 { }
\ No newline at end of file
@@ -0,0 +1,324 @@
+#include "grid.hpp"
+
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+#pragma region uniform_grid
+
+//Runs f(0) through f(count-1), on pool if there is one
+template<typename F>
+static void parallelFor(ThreadPool* pool, int count, F&& f)
+{
+	if (pool == nullptr) {
+		for (int i = 0; i < count; i++) f(i);
+		return;
+	}
+	pool->reserve(count);
+	for (int i = 0; i < count; i++) pool->submit(f, i);
+	pool->wait();
+}
+
+uniform_grid::uniform_grid(std::pmr::memory_resource* mem) :
+	res{ 0, 0, 0 },
+	cellSize{ 0, 0, 0 },
+	invCellSize{ 0, 0, 0 },
+	cellStart(mem),
+	indices(mem)
+{ }
+
+void uniform_grid::setResolution(const aabb& bounds, int count, float density)
+{
+	//Flat scenes would have zero-size cells, so every axis is padded out to at least a sliver of the longest
+	const Vector3 extent = bounds.GetSize();
+	const float longest = std::max(std::max(extent.x, extent.y), extent.z);
+	const float sliver = longest > 0 ? longest * 1e-3f : 1;
+	const Vector3 pad(std::max(sliver - extent.x, 0.0f) / 2, std::max(sliver - extent.y, 0.0f) / 2, std::max(sliver - extent.z, 0.0f) / 2);
+	box = aabb(bounds.min - pad, bounds.max + pad);
+	const float size[3] = { box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z };
+
+	//Cubic cells, sized so there are about density cells per primitive
+	const float volume = size[0] * size[1] * size[2];
+	const float edge = cbrtf(volume / (std::max(density, 1e-3f) * count));
+
+	for (int a = 0; a < 3; a++) {
+		res[a] = std::min(std::max((int)(size[a] / edge), 1), MAX_RESOLUTION);
+		cellSize[a] = size[a] / res[a];
+		invCellSize[a] = cellSize[a] > 0 ? 1 / cellSize[a] : 0;
+	}
+}
+
+void uniform_grid::getCellRange(const aabb& b, int first[3], int last[3]) const
+{
+	const float lo[3] = { b.min.x - box.min.x, b.min.y - box.min.y, b.min.z - box.min.z };
+	const float hi[3] = { b.max.x - box.min.x, b.max.y - box.min.y, b.max.z - box.min.z };
+	for (int a = 0; a < 3; a++) {
+		const float pad = cellSize[a] * 1e-4f;
+		first[a] = std::min(std::max((int)floorf((lo[a] - pad) * invCellSize[a]), 0), res[a] - 1);
+		last [a] = std::min(std::max((int)floorf((hi[a] + pad) * invCellSize[a]), 0), res[a] - 1);
+	}
+}
+
+void uniform_grid::build(const std::pmr::vector<aabb>& primitiveBounds, float density, ThreadPool* pool)
+{
+	const int count = (int)primitiveBounds.size();
+	const int chunks = pool != nullptr ? std::max((int)pool->size(), 1) : 1;
+	const int perChunk = (count + chunks - 1) / chunks;
+
+	cellStart.clear();
+	indices.clear();
+
+	//Scene bounds, one partial box per chunk
+	std::pmr::vector<aabb> partial(chunks, GetResource());
+	std::pmr::vector<int> placed(chunks, 0, GetResource());
+	parallelFor(pool, chunks, [&](int c) {
+		for (int i = c * perChunk; i < std::min(count, (c + 1) * perChunk); i++) {
+			if (primitiveBounds[i].IsEmpty()) continue;
+			partial[c].Expand(primitiveBounds[i]);
+			placed[c]++;
+		}
+	});
+
+	aabb bounds;
+	int nonEmpty = 0;
+	for (int c = 0; c < chunks; c++) {
+		bounds.Expand(partial[c]);
+		nonEmpty += placed[c];
+	}
+	if (nonEmpty == 0) {
+		res[0] = res[1] = res[2] = 0;
+		return;
+	}
+	setResolution(bounds, nonEmpty, density);
+	const int cells = GetCellCount();
+
+	//Counting sort into cells, over a histogram only as big as the grid. Chunks share it,
+	//so it's atomic when there's more than one; counts come out the same whichever order
+	//they're added in. Afterwards each count becomes that cell's write cursor.
+	const auto sortIntoCells = [&](auto& counts) {
+		parallelFor(pool, chunks, [&](int c) {
+			int first[3], last[3];
+			for (int i = c * perChunk; i < std::min(count, (c + 1) * perChunk); i++) {
+				if (primitiveBounds[i].IsEmpty()) continue;
+				getCellRange(primitiveBounds[i], first, last);
+				for (int z = first[2]; z <= last[2]; z++) for (int y = first[1]; y <= last[1]; y++) for (int x = first[0]; x <= last[0]; x++) {
+					counts[x + res[0] * (y + res[1] * z)]++;
+				}
+			}
+		});
+
+		//Prefix sum over cells. Cells are split into blocks: total each block, sum the
+		//totals, then each block fills its own cellStart starting from its share.
+		cellStart.resize((size_t)cells + 1);
+		const int perBlock = (cells + chunks - 1) / chunks;
+		std::pmr::vector<int> blockStart((size_t)chunks + 1, 0, GetResource());
+		parallelFor(pool, chunks, [&](int b) {
+			int total = 0;
+			for (int cell = b * perBlock; cell < std::min(cells, (b + 1) * perBlock); cell++) total += counts[cell];
+			blockStart[b + 1] = total;
+		});
+		for (int b = 0; b < chunks; b++) blockStart[b + 1] += blockStart[b];
+
+		parallelFor(pool, chunks, [&](int b) {
+			int running = blockStart[b];
+			for (int cell = b * perBlock; cell < std::min(cells, (b + 1) * perBlock); cell++) {
+				const int n = counts[cell];
+				cellStart[cell] = running;
+				counts[cell] = running;
+				running += n;
+			}
+		});
+		cellStart[cells] = blockStart[chunks];
+
+		//Drop every primitive into its cells
+		indices.resize(blockStart[chunks]);
+		parallelFor(pool, chunks, [&](int c) {
+			int first[3], last[3];
+			for (int i = c * perChunk; i < std::min(count, (c + 1) * perChunk); i++) {
+				if (primitiveBounds[i].IsEmpty()) continue;
+				getCellRange(primitiveBounds[i], first, last);
+				for (int z = first[2]; z <= last[2]; z++) for (int y = first[1]; y <= last[1]; y++) for (int x = first[0]; x <= last[0]; x++) {
+					indices[counts[x + res[0] * (y + res[1] * z)]++] = i;
+				}
+			}
+		});
+
+		//Chunks raced for slots within a cell, so put each cell's run back in ascending order, same as a serial build
+		if (chunks > 1) parallelFor(pool, chunks, [&](int b) {
+			for (int cell = b * perBlock; cell < std::min(cells, (b + 1) * perBlock); cell++) {
+				std::sort(indices.begin() + cellStart[cell], indices.begin() + cellStart[cell + 1]);
+			}
+		});
+	};
+
+	if (chunks > 1) {
+		std::pmr::vector<std::atomic<int>> counts((size_t)cells, GetResource());
+		sortIntoCells(counts);
+	}
+	else {
+		std::pmr::vector<int> counts((size_t)cells, 0, GetResource());
+		sortIntoCells(counts);
+	}
+}
+
+bool uniform_grid::Suits(const std::pmr::vector<aabb>& primitiveBounds, float density)
+{
+	//Below this, a BVH's packet traversal more than pays for its slower build. Roughly where
+	//rebuild-and-render of one 320x180 frame breaks even, on a single thread.
+	static constexpr int MIN_PRIMITIVES = 10000;
+	//How much bigger than average the biggest primitive can be. Big ones land in lots of cells.
+	static constexpr float MAX_SIZE_RATIO = 8;
+	//Fraction of cells that should have a centroid in them. Less means clusters in empty space.
+	static constexpr float MIN_OCCUPANCY = 0.1f;
+
+	const int count = (int)primitiveBounds.size();
+	if (count < MIN_PRIMITIVES) return false;
+
+	aabb bounds;
+	float totalSize = 0, largest = 0;
+	for (const aabb& b : primitiveBounds) {
+		if (b.IsEmpty()) continue;
+		bounds.Expand(b);
+		const Vector3 s = b.GetSize();
+		const float size = std::max(std::max(s.x, s.y), s.z);
+		totalSize += size;
+		largest = std::max(largest, size);
+	}
+	if (bounds.IsEmpty() || largest > MAX_SIZE_RATIO * totalSize / count) return false;
+
+	uniform_grid probe(primitiveBounds.get_allocator().resource());
+	probe.setResolution(bounds, count, density);
+	const int cells = probe.GetCellCount();
+
+	std::pmr::vector<bool> occupied(cells, false, primitiveBounds.get_allocator().resource());
+	int filled = 0;
+	for (const aabb& b : primitiveBounds) {
+		if (b.IsEmpty()) continue;
+		const Vector3 c = b.GetCenter();
+		int first[3], last[3];
+		probe.getCellRange(aabb(c, c), first, last);
+		const int cell = first[0] + probe.res[0] * (first[1] + probe.res[1] * first[2]);
+		if (!occupied[cell]) {
+			occupied[cell] = true;
+			filled++;
+		}
+	}
+	return filled >= MIN_OCCUPANCY * std::min(cells, count);
+}
+
+#pragma endregion uniform_grid
+
+#pragma region UniformGrid
+
+UniformGrid::UniformGrid(const std::vector<Traceable*>& objects, float density, unsigned int threadCount, std::pmr::memory_resource* mem) :
+	objects(objects.begin(), objects.end(), mem),
+	grid(mem),
+	density{ density },
+	threadCount{ threadCount }
+{
+	rebuild();
+}
+
+UniformGrid::UniformGrid(const std::vector<Traceable*>& objects, ThreadPool& pool, float density, std::pmr::memory_resource* mem) :
+	objects(objects.begin(), objects.end(), mem),
+	grid(mem),
+	density{ density },
+	threadCount{ pool.size() }
+{
+	rebuild((int)objects.size() < PARALLEL_THRESHOLD ? nullptr : &pool);
+}
+
+void UniformGrid::rebuild()
+{
+	if ((int)objects.size() < PARALLEL_THRESHOLD || ThreadPool::resolveThreadCount(threadCount) == 1) {
+		rebuild(nullptr);
+		return;
+	}
+	ThreadPool pool(threadCount);
+	rebuild(&pool);
+}
+
+void UniformGrid::rebuild(ThreadPool& pool)
+{
+	rebuild(&pool);
+}
+
+void UniformGrid::rebuild(ThreadPool* pool)
+{
+	std::pmr::vector<aabb> primitiveBounds(objects.size(), grid.GetResource());
+	const int count = (int)objects.size();
+	const int chunks = pool != nullptr ? std::max((int)pool->size(), 1) : 1;
+	const int perChunk = (count + chunks - 1) / chunks;
+	parallelFor(pool, chunks, [&](int c) {
+		for (int i = c * perChunk; i < std::min(count, (c + 1) * perChunk); i++) primitiveBounds[i] = objects[i]->bounds();
+	});
+	grid.build(primitiveBounds, density, pool);
+}
+
+void UniformGrid::trace(const Ray& ray, hit_buffer& out)
+{
+	//Objects spanning several cells are listed in each, so gather them first and trace each
+	//once. Usually a handful, so the list stays on the stack.
+	static constexpr int LOCAL_CAPACITY = 64;
+	int storage[LOCAL_CAPACITY];
+	std::pmr::monotonic_buffer_resource local(storage, sizeof(storage));
+	std::pmr::vector<int> candidates(&local);
+	candidates.reserve(LOCAL_CAPACITY);
+
+	grid.traverse(ray, 0, FLT_MAX, [&](const int& first, const int& count) {
+		candidates.insert(candidates.end(), grid.indices.begin() + first, grid.indices.begin() + first + count);
+		return false;
+	});
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	for (int i : candidates) objects[i]->trace(ray, out);
+}
+
+bool UniformGrid::trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out)
+{
+	//Every hit shrinks the search range, and traverse() stops at the first cell past it
+	bool found = false;
+	float closest = t_max;
+
+	grid.traverse(ray, t_min, closest, [&](const int& first, const int& count) {
+		for (int i = first; i < first + count; i++) {
+			if (objects[grid.indices[i]]->trace_closest(ray, t_min, closest, out)) {
+				closest = out.t;
+				found = true;
+			}
+		}
+		return false;
+	});
+
+	return found;
+}
+
+bool UniformGrid::trace_any(const Ray& ray, const float& t_min, const float& t_max)
+{
+	bool found = false;
+
+	grid.traverse(ray, t_min, t_max, [&](const int& first, const int& count) {
+		for (int i = first; i < first + count; i++) {
+			if (objects[grid.indices[i]]->trace_any(ray, t_min, t_max)) return found = true;
+		}
+		return false;
+	});
+
+	return found;
+}
+
+aabb UniformGrid::bounds() const
+{
+	return grid.GetBounds();
+}
+
+Vector3 UniformGrid::normal_at(const Vector3& /*pos*/)
+{
+	throw std::logic_error("UniformGrid has no surface of its own; use trace_hit::normal instead");
+}
+
+#pragma endregion UniformGrid
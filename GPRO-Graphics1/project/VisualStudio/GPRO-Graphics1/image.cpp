@@ -1,54 +1,316 @@
 #include "image.hpp"
 
 #include <stdexcept>
+#include <vector>
+#include <cstring>
 
-inline int Image::_ind(int x, int y) const
+#pragma region Binary encoding
+
+//Same value P3 writes, (int)(v * color_space/scale), clamped so it fits in maxval. NaN becomes 0.
+static inline int quantize(const float& v, const float& maxval)
+{
+	return (int)(v > 0 ? (v < maxval ? v : maxval) : 0);
+}
+
+//Converts pixels to 8-bit RGB in one pass. out needs 3*count bytes.
+static void encode8(const Color* pixels, const int& count, const float& maxval, unsigned char* out)
+{
+	int i = 0;
+
+#ifdef GPRO_SIMD_SSE
+	//4 pixels at a time, one channel per register
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 ceiling = _mm_set1_ps(maxval);
+	//Stops short of the last pixel, which the scalar loop writes, so stores never run past out
+	for (; i + 4 < count; i += 4) {
+		const Color* p = pixels + i;
+		const __m128 factor = _mm_div_ps(ceiling, _mm_set_ps(p[3].GetScale(), p[2].GetScale(), p[1].GetScale(), p[0].GetScale()));
+		__m128 r = _mm_mul_ps(_mm_set_ps(p[3].r, p[2].r, p[1].r, p[0].r), factor);
+		__m128 g = _mm_mul_ps(_mm_set_ps(p[3].g, p[2].g, p[1].g, p[0].g), factor);
+		__m128 b = _mm_mul_ps(_mm_set_ps(p[3].b, p[2].b, p[1].b, p[0].b), factor);
+
+		//Operand order matches quantize, so NaN clamps to 0 here too
+		r = _mm_min_ps(_mm_max_ps(r, zero), ceiling);
+		g = _mm_min_ps(_mm_max_ps(g, zero), ceiling);
+		b = _mm_min_ps(_mm_max_ps(b, zero), ceiling);
+
+		//Pack each pixel into the low 3 bytes of a 32-bit lane...
+		const __m128i rgb = _mm_or_si128(_mm_cvttps_epi32(r), _mm_or_si128(
+			_mm_slli_epi32(_mm_cvttps_epi32(g),  8),
+			_mm_slli_epi32(_mm_cvttps_epi32(b), 16)));
+
+		//...then write them 3 bytes apart. Each 4-byte store's top byte gets overwritten by the next pixel.
+		alignas(16) unsigned int words[4];
+		_mm_store_si128((__m128i*)words, rgb);
+		for (int k = 0; k < 4; k++) memcpy(out + 3*(i+k), &words[k], 4);
+	}
+#endif
+
+	for (; i < count; i++) {
+		const float factor = maxval / pixels[i].GetScale();
+		out[3*i+0] = (unsigned char)quantize(pixels[i].r * factor, maxval);
+		out[3*i+1] = (unsigned char)quantize(pixels[i].g * factor, maxval);
+		out[3*i+2] = (unsigned char)quantize(pixels[i].b * factor, maxval);
+	}
+}
+
+//Converts pixels to 16-bit big-endian RGB. out needs 6*count bytes.
+static void encode16(const Color* pixels, const int& count, const float& maxval, unsigned char* out)
+{
+	for (int i = 0; i < count; i++) {
+		const float factor = maxval / pixels[i].GetScale();
+		const int channels[3] = {
+			quantize(pixels[i].r * factor, maxval),
+			quantize(pixels[i].g * factor, maxval),
+			quantize(pixels[i].b * factor, maxval)
+		};
+		for (int c = 0; c < 3; c++) {
+			out[6*i + 2*c + 0] = (unsigned char)(channels[c] >> 8);
+			out[6*i + 2*c + 1] = (unsigned char)(channels[c] & 0xFF);
+		}
+	}
+}
+
+#pragma endregion Binary encoding
+
+#pragma region Half floats
+
+//Round-to-nearest-even float -> half, and exact half -> float. Inf and NaN survive both ways.
+static inline unsigned short toHalf(const float& value)
 {
-	if (x < 0 || x >= width || y < 0 || y >= height) throw std::invalid_argument("Index out of bounds!");
-	return x+y*width;
+	unsigned int bits; memcpy(&bits, &value, 4);
+	const unsigned int sign = (bits >> 16) & 0x8000;
+	bits &= 0x7FFFFFFF;
+
+	if (bits >= (127 + 16) << 23) return (unsigned short)(sign | (bits > 0x7F800000 ? 0x7E00 : 0x7C00)); //Too big, Inf, or NaN
+	if (bits < 113 << 23) {
+		//Subnormal or zero. Adding a magic number lets the FPU do the rounding.
+		const unsigned int magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+		float magic; memcpy(&magic, &magicBits, 4);
+		float f; memcpy(&f, &bits, 4);
+		f += magic;
+		unsigned int out; memcpy(&out, &f, 4);
+		return (unsigned short)(sign | (out - magicBits));
+	}
+
+	//Normal. Rebias exponent, then round the 13 dropped mantissa bits to even.
+	bits += ((unsigned int)(15 - 127) << 23) + 0xFFF + ((bits >> 13) & 1);
+	return (unsigned short)(sign | (bits >> 13));
 }
 
+static inline float fromHalf(const unsigned short& half)
+{
+	unsigned int bits = (half & 0x7FFF) << 13;
+	const unsigned int exponent = bits & (0x7C00 << 13);
+	bits += (127 - 15) << 23;
+
+	if (exponent == 0x7C00 << 13) bits += (128 - 16) << 23; //Inf or NaN
+	else if (exponent == 0) {
+		//Subnormal or zero. Renormalize through the FPU.
+		const unsigned int magicBits = 113 << 23;
+		float magic; memcpy(&magic, &magicBits, 4);
+		bits += 1 << 23;
+		float f; memcpy(&f, &bits, 4);
+		f -= magic;
+		memcpy(&bits, &f, 4);
+	}
+
+	bits |= (unsigned int)(half & 0x8000) << 16;
+	float out; memcpy(&out, &bits, 4);
+	return out;
+}
+
+#pragma endregion Half floats
+
 Image::Image(const int& w, const int& h) : Image(w, h, DEFAULT_COLOR_SPACE) {}
 
-Image::Image(const int& w, const int& h, const float& c) : width(w), height(h), color_space(c), pixels(new Color[w * h])
+Image::Image(const int& w, const int& h, const float& c) :
+	Image(w, h, c, (c >= 1 && c <= 255 && c == (int)c) ? pixel_format::RGB8 : pixel_format::RGB32F)
 { }
 
-Image::~Image()
+Image::Image(const int& w, const int& h, const float& c, const pixel_format& format, const pixel_layout& layout, std::pmr::memory_resource* mem) :
+	data(mem),
+	tilesX((w + TILE_SIZE - 1) / TILE_SIZE),
+	width(w),
+	height(h),
+	color_space(c),
+	format(format),
+	layout(layout)
 {
-	if (pixels != nullptr) { delete[] pixels; pixels = nullptr; }
+	if (w < 0 || h < 0) throw std::invalid_argument("Image size can't be negative!");
+	if (format == pixel_format::RGB8 && !(c >= 1 && c <= 255 && c == (int)c)) throw std::invalid_argument("RGB8 needs a whole-number color space from 1 to 255!");
+
+	//Tiled layouts store whole tiles, even past the right and bottom edges
+	const size_t pixels = layout == pixel_layout::ROW_MAJOR ? (size_t)w * h : (size_t)tilesX * ((h + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE * TILE_SIZE;
+	data.resize(pixels * BytesPerPixel(format));
 }
 
-void Image::write_to(std::ostream& out)
+int Image::BytesPerPixel(const pixel_format& format)
 {
-	if (!out.good()) throw std::invalid_argument("File is not open!");
+	switch (format) {
+	case pixel_format::RGB8   : return 3;
+	case pixel_format::RGBA16F: return 8;
+	case pixel_format::RGB32F : return 12;
+	}
+	throw std::invalid_argument("Unknown pixel format");
+}
+
+Color Image::get_pixel(const int& x, const int& y) const
+{
+	Color out;
+	get_pixels(x, y, &out, 1);
+	return out;
+}
+
+void Image::set_pixel(const int& x, const int& y, const Color& value)
+{
+	set_pixels(x, y, &value, 1);
+}
+
+template<typename F>
+void Image::_forEachRun(int x, int y, const int& count, F&& run) const
+{
+#ifdef _DEBUG
+	if (x + y*width + count > width * height) throw std::invalid_argument("Index out of bounds!");
+#endif
+
+	//Rows follow each other directly, so any span is one run
+	if (layout == pixel_layout::ROW_MAJOR) {
+		run(_ind(x, y), 0, count);
+		return;
+	}
 
-	//Allow binary write mode (doesn't work!)
-	//bool use_binary = false;// color_space < 256;
+	for (int done = 0; done < count; ) {
+		int n = _runLength(x);
+		if (n > count - done) n = count - done;
+		run(_ind(x, y), done, n);
+
+		done += n;
+		x += n;
+		if (x == width) { x = 0; y++; }
+	}
+}
+
+void Image::get_pixels(const int& x, const int& y, Color* out, const int& count) const
+{
+	_forEachRun(x, y, count, [&](const int& first, const int& offset, const int& n) { _load(first, out + offset, n); });
+}
+
+void Image::set_pixels(const int& x, const int& y, const Color* in, const int& count)
+{
+	_forEachRun(x, y, count, [&](const int& first, const int& offset, const int& n) { _store(first, in + offset, n); });
+}
+
+void Image::_load(const int& first, Color* out, const int& count) const
+{
+	switch (format) {
+	case pixel_format::RGB8: {
+		//Stored values are already in output units, so hand them back at that scale
+		const unsigned char* p = data.data() + 3*(size_t)first;
+		for (int i = 0; i < count; i++, p += 3) out[i] = Color::FromRGB(p[0], p[1], p[2], (float)(int)color_space);
+		break;
+	}
+	case pixel_format::RGBA16F: {
+		const unsigned char* p = data.data() + 8*(size_t)first;
+		for (int i = 0; i < count; i++, p += 8) {
+			unsigned short h[4]; memcpy(h, p, 8);
+			out[i] = Color::FromRGB(fromHalf(h[0]), fromHalf(h[1]), fromHalf(h[2]));
+		}
+		break;
+	}
+	case pixel_format::RGB32F: {
+		const unsigned char* p = data.data() + 12*(size_t)first;
+		for (int i = 0; i < count; i++, p += 12) {
+			float f[3]; memcpy(f, p, 12);
+			out[i] = Color::FromRGB(f[0], f[1], f[2]);
+		}
+		break;
+	}
+	}
+}
 
-	//Write header
+void Image::_store(const int& first, const Color* in, const int& count)
+{
+	switch (format) {
+	case pixel_format::RGB8:
+		//Same quantization P6 does at write time
+		encode8(in, count, (float)(int)color_space, data.data() + 3*(size_t)first);
+		break;
+	case pixel_format::RGBA16F: {
+		unsigned char* p = data.data() + 8*(size_t)first;
+		for (int i = 0; i < count; i++, p += 8) {
+			const float scale = in[i].GetScale();
+			const unsigned short h[4] = { toHalf(in[i].r / scale), toHalf(in[i].g / scale), toHalf(in[i].b / scale), toHalf(1) };
+			memcpy(p, h, 8);
+		}
+		break;
+	}
+	case pixel_format::RGB32F: {
+		unsigned char* p = data.data() + 12*(size_t)first;
+		for (int i = 0; i < count; i++, p += 12) {
+			const float scale = in[i].GetScale();
+			const float f[3] = { in[i].r / scale, in[i].g / scale, in[i].b / scale };
+			memcpy(p, f, 12);
+		}
+		break;
+	}
+	}
+}
 
-	//out << (use_binary?"P6":"P3") << " ";
-	out << "P3" << " ";
-	out << width << " " << height << " ";
-	out << color_space << " ";
+void Image::write_to(std::ostream& out, const image_format& format) const
+{
+	if (!out.good()) throw std::invalid_argument("File is not open!");
 
-	//Write data
+	write_header(out, width, height, color_space, format);
 
-	/*if(use_binary) {
-		//Binary write mode (doesn't work)
-		for (int x = 0; x < width; x++) for (int y = 0; y < height; y++) {
-			Color c = pixel_at(x, y);
-			//Print using 2-byte 565
-			char r = (int)(c.r); if (is_illegal(r)) r--;
-			char g = (int)(c.g); if (is_illegal(g)) g--;
-			char b = (int)(c.b); if (is_illegal(b)) b--;
-			out << r << g << b;
+	if (this->format == pixel_format::RGB8 && layout == pixel_layout::ROW_MAJOR && format == image_format::P6) {
+		//Already stored exactly as P6 wants it
+		out.write((const char*)data.data(), data.size());
+	}
+	else {
+		//Otherwise convert a row at a time, which also puts tiled layouts back in row order
+		std::vector<Color> row(width);
+		std::vector<unsigned char> scratch;
+		for (int y = 0; y < height; y++) {
+			get_pixels(0, y, row.data(), width);
+			write_pixels(out, row.data(), width, color_space, format, scratch);
 		}
 	}
-	else /**/{
+
+	out.flush(); //So a full disk shows up here, not when out is closed
+	if (!out.good()) throw std::runtime_error("Couldn't write the whole image!");
+}
+
+void Image::write_header(std::ostream& out, const int& width, const int& height, const float& color_space, const image_format& format)
+{
+	if (format == image_format::P6) {
+		const int maxval = (int)color_space;
+		if (maxval < 1 || maxval > 65535) throw std::invalid_argument("P6 only supports color spaces from 1 to 65535!");
+		out << "P6\n" << width << " " << height << "\n" << maxval << "\n";
+	}
+	else {
+		out << "P3" << " ";
+		out << width << " " << height << " ";
+		out << color_space << " ";
+	}
+}
+
+void Image::write_pixels(std::ostream& out, const Color* pixels, const int& count, const float& color_space, const image_format& format, std::vector<unsigned char>& scratch)
+{
+	if (format == image_format::P6) {
+		//Convert everything up front, then write it in one call
+		const int maxval = (int)color_space;
+		const bool wide = maxval > 255;
+		scratch.resize(count * (wide ? 6 : 3));
+		if (wide) encode16(pixels, count, (float)maxval, scratch.data());
+		else      encode8 (pixels, count, (float)maxval, scratch.data());
+
+		out.write((const char*)scratch.data(), scratch.size());
+	}
+	else {
 		//ASCII write mode, uses more space but has unbounded maximum color space
-		for (int y = 0; y < height; y++) for (int x = 0; x < width; x++) {
-			Color c = pixel_at(x, y).RemapScale(color_space);
+		for (int i = 0; i < count; i++) {
+			Color c = Color(pixels[i]).RemapScale(color_space);
 			out << (int)(c.r) << " " << (int)(c.g) << " " << (int)(c.b) << " ";
 		}
 	}
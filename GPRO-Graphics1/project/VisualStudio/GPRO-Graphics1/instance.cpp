@@ -0,0 +1,195 @@
+#include "instance.hpp"
+
+#include <cfloat>
+#include <stdexcept>
+
+#pragma region affine
+
+affine::affine(const mat4& mat)
+{
+	for (int x = 0; x < 4; x++) for (int y = 0; y < 3; y++) m[x + y * 4] = mat.at_c(x, y);
+}
+
+affine affine::Identity()
+{
+	return affine(mat4::Identity());
+}
+
+mat4 affine::ToMat4() const
+{
+	mat4 out = mat4::Identity();
+	for (int x = 0; x < 4; x++) for (int y = 0; y < 3; y++) out(x, y) = m[x + y * 4];
+	return out;
+}
+
+#pragma endregion affine
+
+#pragma region InstanceSet
+
+InstanceSet::InstanceSet(int maxLeafSize, std::pmr::memory_resource* mem) :
+	geometries(mem),
+	materials(mem),
+	instances(mem),
+	tree(mem),
+	maxLeafSize{ maxLeafSize }
+{ }
+
+int InstanceSet::addGeometry(Traceable* geometry)
+{
+	if (geometry == nullptr) throw std::invalid_argument("Can't add null geometry");
+	geometries.push_back(geometry);
+	return (int)geometries.size() - 1;
+}
+
+int InstanceSet::addMaterial(const Color& color)
+{
+	materials.push_back(color);
+	return (int)materials.size() - 1;
+}
+
+int InstanceSet::add(const int& geometry, const mat4& localToWorld, const int& material)
+{
+	if (geometry < 0 || geometry >= (int)geometries.size()) throw std::invalid_argument("No such geometry!");
+	if (material != NO_MATERIAL && (material < 0 || material >= (int)materials.size())) throw std::invalid_argument("No such material!");
+
+	instance inst;
+	inst.worldToLocal = affine(localToWorld.Inverse());
+	inst.geometry = geometry;
+	inst.material = material;
+	instances.push_back(inst);
+	return (int)instances.size() - 1;
+}
+
+void InstanceSet::setTransform(const int& index, const mat4& localToWorld)
+{
+	if (index < 0 || index >= (int)instances.size()) throw std::invalid_argument("No such instance!");
+	instances[index].worldToLocal = affine(localToWorld.Inverse());
+}
+
+void InstanceSet::rebuild()
+{
+	//Each geometry's box, moved into world space by every instance of it
+	std::pmr::vector<aabb> localBounds(tree.GetResource());
+	localBounds.reserve(geometries.size());
+	for (Traceable* geometry : geometries) localBounds.push_back(geometry->bounds());
+
+	std::pmr::vector<aabb> primitiveBounds(tree.GetResource());
+	primitiveBounds.reserve(instances.size());
+	for (const instance& inst : instances) {
+		const aabb& local = localBounds[inst.geometry];
+		aabb world;
+		if (!local.IsEmpty()) {
+			const affine localToWorld(inst.worldToLocal.ToMat4().Inverse());
+			for (int i = 0; i < 8; i++) {
+				world.Expand(localToWorld.TransformPoint(Vector3(
+					(i & 1) ? local.max.x : local.min.x,
+					(i & 2) ? local.max.y : local.min.y,
+					(i & 4) ? local.max.z : local.min.z
+				)));
+			}
+		}
+		primitiveBounds.push_back(world);
+	}
+
+	tree.build(primitiveBounds, maxLeafSize);
+}
+
+void InstanceSet::toWorld(const instance& inst, const Ray& ray, trace_hit& hit) const
+{
+	//Normals go through the inverse transpose of localToWorld, which is just worldToLocal transposed
+	hit.position = ray.GetByT(hit.t);
+	hit.normal = inst.worldToLocal.TransposeTransformVector(hit.normal).Normalize();
+	if (inst.material != NO_MATERIAL) hit.color = materials[inst.material];
+}
+
+void InstanceSet::trace(const Ray& ray, hit_buffer& out)
+{
+	tree.traverse(ray, 0, FLT_MAX, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			const instance& inst = instances[tree.indices[i]];
+			const size_t first = out.size();
+			geometries[inst.geometry]->trace(toLocal(inst, ray), out);
+			for (size_t h = first; h < out.size(); h++) toWorld(inst, ray, out[h]);
+		}
+		return false;
+	});
+}
+
+bool InstanceSet::trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out)
+{
+	bool found = false;
+	float closest = t_max;
+
+	tree.traverse(ray, t_min, closest, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			const instance& inst = instances[tree.indices[i]];
+			if (geometries[inst.geometry]->trace_closest(toLocal(inst, ray), t_min, closest, out)) {
+				toWorld(inst, ray, out);
+				closest = out.t;
+				found = true;
+			}
+		}
+		return false;
+	});
+
+	return found;
+}
+
+bool InstanceSet::trace_any(const Ray& ray, const float& t_min, const float& t_max)
+{
+	bool found = false;
+
+	tree.traverse(ray, t_min, t_max, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			const instance& inst = instances[tree.indices[i]];
+			if (geometries[inst.geometry]->trace_any(toLocal(inst, ray), t_min, t_max)) return found = true;
+		}
+		return false;
+	});
+
+	return found;
+}
+
+void InstanceSet::trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes)
+{
+	const pfloat ox = pfloat::Load(rays.ox), oy = pfloat::Load(rays.oy), oz = pfloat::Load(rays.oz);
+	const pfloat dx = pfloat::Load(rays.dx), dy = pfloat::Load(rays.dy), dz = pfloat::Load(rays.dz);
+
+	tree.traverse(rays, t_min, out.t_max, lanes, [&](const bvh_node& leaf, const int& active) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			const instance& inst = instances[tree.indices[i]];
+			const float* w = inst.worldToLocal.m;
+
+			//The whole packet moves into the instance's space at once, same math as toLocal
+			ray_packet local;
+			(pfloat(w[0])*ox + pfloat(w[1])*oy + pfloat(w[ 2])*oz + pfloat(w[ 3])).Store(local.ox);
+			(pfloat(w[4])*ox + pfloat(w[5])*oy + pfloat(w[ 6])*oz + pfloat(w[ 7])).Store(local.oy);
+			(pfloat(w[8])*ox + pfloat(w[9])*oy + pfloat(w[10])*oz + pfloat(w[11])).Store(local.oz);
+			(pfloat(w[0])*dx + pfloat(w[1])*dy + pfloat(w[ 2])*dz).Store(local.dx);
+			(pfloat(w[4])*dx + pfloat(w[5])*dy + pfloat(w[ 6])*dz).Store(local.dy);
+			(pfloat(w[8])*dx + pfloat(w[9])*dy + pfloat(w[10])*dz).Store(local.dz);
+
+			//Lanes whose t_max shrinks were hit by this instance, and need moving back out
+			alignas(32) float before[ray_packet::WIDTH];
+			for (int l = 0; l < ray_packet::WIDTH; l++) before[l] = out.t_max[l];
+
+			geometries[inst.geometry]->trace_packet(local, t_min, out, active);
+
+			for (int l = 0; l < ray_packet::WIDTH; l++) {
+				if (((active >> l) & 1) && out.t_max[l] != before[l]) toWorld(inst, rays.GetRay(l), out.hits[l]);
+			}
+		}
+	});
+}
+
+aabb InstanceSet::bounds() const
+{
+	return tree.GetBounds();
+}
+
+Vector3 InstanceSet::normal_at(const Vector3& /*pos*/)
+{
+	throw std::logic_error("InstanceSet has no surface of its own; use trace_hit::normal instead");
+}
+
+#pragma endregion InstanceSet
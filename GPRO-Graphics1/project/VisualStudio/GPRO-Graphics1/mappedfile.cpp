@@ -0,0 +1,84 @@
+#include "mappedfile.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const std::string& path) :
+	view{ nullptr },
+	length{ 0 },
+	file{ INVALID_HANDLE_VALUE },
+	mapping{ nullptr }
+{
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Couldn't open " + path);
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("Couldn't read the size of " + path);
+	}
+	length = (size_t)fileSize.QuadPart;
+	if (length == 0) return; //Can't map nothing
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping != nullptr) view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		if (mapping != nullptr) CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Couldn't map " + path);
+	}
+}
+
+mapped_file::~mapped_file()
+{
+	if (view != nullptr) UnmapViewOfFile(view);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+#else
+
+mapped_file::mapped_file(const std::string& path) :
+	view{ nullptr },
+	length{ 0 }
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Couldn't open " + path);
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Couldn't read the size of " + path);
+	}
+	length = (size_t)info.st_size;
+
+	//The mapping outlives the descriptor, so it can be closed right away
+	if (length > 0) {
+		void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Couldn't map " + path);
+		}
+		view = (const unsigned char*)p;
+	}
+	close(fd);
+}
+
+mapped_file::~mapped_file()
+{
+	if (view != nullptr) munmap((void*)view, length);
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "mat4.hpp"
+
+#include <stdexcept>
+
+mat4 mat4::Zero()
+{
+	mat4 out;
+	for (int i = 0; i < 16; i++) out.m[i] = 0;
+	return out;
+}
+
+mat4 mat4::Identity()
+{
+	mat4 out = Zero();
+	out.m[0] = out.m[5] = out.m[10] = out.m[15] = 1;
+	return out;
+}
+
+mat4 mat4::Translate(const Vector3& vec)
+{
+	mat4 out = Identity();
+	out(3, 0) = vec.x;
+	out(3, 1) = vec.y;
+	out(3, 2) = vec.z;
+	return out;
+}
+
+mat4::mat4(const matrix& mat)
+{
+	if (mat.size != 4) throw std::invalid_argument("Only 4x4 matrices can be converted to mat4!");
+	for (int x = 0; x < 4; x++) for (int y = 0; y < 4; y++) m[_ind(x, y)] = mat.at_c(x, y);
+}
+
+matrix mat4::ToMatrix() const
+{
+	matrix out = matrix::Zero(4);
+	for (int x = 0; x < 4; x++) for (int y = 0; y < 4; y++) out(x, y) = m[_ind(x, y)];
+	return out;
+}
+
+//Both of these expand along 2x2 sub-determinants of the top and bottom row pairs.
+//Names are row-then-column, ie. a12 is row 1, column 2.
+#define MAT4_UNPACK \
+	const float a00 = m[ 0], a01 = m[ 1], a02 = m[ 2], a03 = m[ 3]; \
+	const float a10 = m[ 4], a11 = m[ 5], a12 = m[ 6], a13 = m[ 7]; \
+	const float a20 = m[ 8], a21 = m[ 9], a22 = m[10], a23 = m[11]; \
+	const float a30 = m[12], a31 = m[13], a32 = m[14], a33 = m[15]; \
+	const float s0 = a00*a11 - a10*a01; \
+	const float s1 = a00*a12 - a10*a02; \
+	const float s2 = a00*a13 - a10*a03; \
+	const float s3 = a01*a12 - a11*a02; \
+	const float s4 = a01*a13 - a11*a03; \
+	const float s5 = a02*a13 - a12*a03; \
+	const float c0 = a20*a31 - a30*a21; \
+	const float c1 = a20*a32 - a30*a22; \
+	const float c2 = a20*a33 - a30*a23; \
+	const float c3 = a21*a32 - a31*a22; \
+	const float c4 = a21*a33 - a31*a23; \
+	const float c5 = a22*a33 - a32*a23;
+
+float mat4::Determinant() const
+{
+	MAT4_UNPACK
+	return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+}
+
+mat4 mat4::Inverse() const
+{
+	MAT4_UNPACK
+	const float det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+	if (det == 0) throw std::runtime_error("This matrix has no inverse!");
+	const float inv = 1 / det;
+
+	mat4 out;
+	out.m[ 0] = ( a11*c5 - a12*c4 + a13*c3) * inv;
+	out.m[ 1] = (-a01*c5 + a02*c4 - a03*c3) * inv;
+	out.m[ 2] = ( a31*s5 - a32*s4 + a33*s3) * inv;
+	out.m[ 3] = (-a21*s5 + a22*s4 - a23*s3) * inv;
+
+	out.m[ 4] = (-a10*c5 + a12*c2 - a13*c1) * inv;
+	out.m[ 5] = ( a00*c5 - a02*c2 + a03*c1) * inv;
+	out.m[ 6] = (-a30*s5 + a32*s2 - a33*s1) * inv;
+	out.m[ 7] = ( a20*s5 - a22*s2 + a23*s1) * inv;
+
+	out.m[ 8] = ( a10*c4 - a11*c2 + a13*c0) * inv;
+	out.m[ 9] = (-a00*c4 + a01*c2 - a03*c0) * inv;
+	out.m[10] = ( a30*s4 - a31*s2 + a33*s0) * inv;
+	out.m[11] = (-a20*s4 + a21*s2 - a23*s0) * inv;
+
+	out.m[12] = (-a10*c3 + a11*c1 - a12*c0) * inv;
+	out.m[13] = ( a00*c3 - a01*c1 + a02*c0) * inv;
+	out.m[14] = (-a30*s3 + a31*s1 - a32*s0) * inv;
+	out.m[15] = ( a20*s3 - a21*s1 + a22*s0) * inv;
+	return out;
+}
+
+#undef MAT4_UNPACK
+
+mat4 mat4::Transpose() const
+{
+	mat4 out;
+	for (int x = 0; x < 4; x++) for (int y = 0; y < 4; y++) out.m[_ind(y, x)] = m[_ind(x, y)];
+	return out;
+}
+
+mat4 mat4::operator*(const mat4& rhs) const
+{
+	mat4 out;
+	for (int row = 0; row < 4; row++) for (int col = 0; col < 4; col++) {
+		out.m[_ind(col, row)] =
+			m[_ind(0, row)] * rhs.m[_ind(col, 0)] +
+			m[_ind(1, row)] * rhs.m[_ind(col, 1)] +
+			m[_ind(2, row)] * rhs.m[_ind(col, 2)] +
+			m[_ind(3, row)] * rhs.m[_ind(col, 3)];
+	}
+	return out;
+}
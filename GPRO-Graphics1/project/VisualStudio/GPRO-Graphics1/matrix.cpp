@@ -3,12 +3,8 @@
 #include "moremath.inl"
 
 #include <stdexcept>
-
-inline int matrix::_ind(int x, int y) const
-{
-	if (x < 0 || x >= size || y < 0 || y >= size) throw std::invalid_argument("Index out of bounds!");
-	return x + y * size;
-}
+#include <algorithm> /* swap_ranges, copy_n */
+#include <cmath>
 
 Vector3 matrix::TransformPoint(const Vector3& point) const
 {
@@ -30,18 +26,25 @@ Vector3 matrix::TransformVector(const Vector3& vector) const
 
 matrix matrix::Inverse() const
 {
-	float det = Determinant();
-	if(det == 0) throw std::runtime_error("This matrix has no inverse!");
-
-	matrix adj = Adjugate();
-	matrix out = Zero(size);
-	for(int x = 0; x < size; x++) for(int y = 0; y < size; y++) out(x,y) = adj(x,y) / det;
+	matrix lu(*this, mem);
+	std::pmr::vector<int> pivots(size, mem);
+	if (lu.DecomposeLU(pivots.data()) == 0) throw std::runtime_error("This matrix has no inverse!");
+
+	//Column j of the inverse solves this * x = (column j of the identity)
+	std::pmr::vector<float> e(size, 0.0f, mem), x(size, mem);
+	matrix out(size, mem);
+	for (int j = 0; j < size; j++) {
+		e[j] = 1;
+		lu.SolveLU(pivots.data(), e.data(), x.data());
+		e[j] = 0;
+		for (int i = 0; i < size; i++) out(j, i) = x[i];
+	}
 	return out;
 }
 
 float matrix::Determinant() const
 {
-	//I'm lazy so it's hardcoded to save ambiguity. See comment under 'else' block
+	//Closed forms are exact and cheaper for the small ones
 	if (size == 1) {
 		//Is this even a matrix?
 		return at_c(0,0);
@@ -53,26 +56,86 @@ float matrix::Determinant() const
 	else if (size == 3) {
 		return at_c(0,0)*at_c(1,1)*at_c(2,2) + at_c(1,0)*at_c(2,1)*at_c(0,2) + at_c(2,0)*at_c(0,1)*at_c(1,2) - at_c(0,0)*at_c(2,1)*at_c(1,2) - at_c(1,0)*at_c(0,1)*at_c(2,2) - at_c(2,0)*at_c(1,1)*at_c(0,2);
 	}
-	else if (size == 4) {
-		return    at_c(0,0) * DropXY(0, 0).Determinant()
-				- at_c(1,0) * DropXY(1, 0).Determinant()
-				+ at_c(2,0) * DropXY(2, 0).Determinant()
-				- at_c(3,0) * DropXY(3, 0).Determinant();
-	}
 	else {
-		//Recursively calculate determinant. This probably works but I haven't
-		//tested it yet. I can probably remove the proverbial duct tape holding
-		//the hot mess that was this method together, but I don't feel like doing
-		//the thorough testing needed.
-		float sum = 0;
-		for (int i = 0; i < size; i++) sum += DropXY(i, 0).Determinant() * (i % 2 == 0 ? 1 : -1);
-		return sum;
+		//Product of U's diagonal, flipped once per row swap
+		matrix lu(*this, mem);
+		std::pmr::vector<int> pivots(size, mem);
+		float det = (float)lu.DecomposeLU(pivots.data());
+		for (int i = 0; i < size && det != 0; i++) det *= lu.m[i*size + i];
+		return det;
+	}
+}
+
+std::vector<float> matrix::Solve(const std::vector<float>& b) const
+{
+	if ((int)b.size() != size) throw std::invalid_argument("Right-hand side must have one value per row!");
+	std::vector<float> x(size);
+	Solve(b.data(), x.data());
+	return x;
+}
+
+void matrix::Solve(const float* b, float* x) const
+{
+	matrix lu(*this, mem);
+	std::pmr::vector<int> pivots(size, mem);
+	if (lu.DecomposeLU(pivots.data()) == 0) throw std::runtime_error("This matrix is singular, so there's no unique solution!");
+	lu.SolveLU(pivots.data(), b, x);
+}
+
+int matrix::DecomposeLU(int* pivots)
+{
+	//Rows are contiguous (y is the row), so everything below works on whole rows of m
+	int sign = 1;
+	for (int i = 0; i < size; i++) pivots[i] = i;
+
+	for (int k = 0; k < size; k++) {
+		//Partial pivoting: bring up the row with the biggest value in this column
+		int best = k;
+		for (int r = k + 1; r < size; r++) if (fabsf(m[r*size + k]) > fabsf(m[best*size + k])) best = r;
+		if (!(m[best*size + k] != 0)) return 0; //Whole column is zero (or NaN), so it's singular
+
+		if (best != k) {
+			std::swap_ranges(m + k*size, m + k*size + size, m + best*size);
+			std::swap(pivots[k], pivots[best]);
+			sign = -sign;
+		}
+
+		//Eliminate below the pivot, leaving the multipliers behind as L
+		const float* pivotRow = m + k*size;
+		const float inv = 1 / pivotRow[k];
+		for (int r = k + 1; r < size; r++) {
+			float* row = m + r*size;
+			const float f = row[k] *= inv;
+			if (f == 0) continue;
+			for (int c = k + 1; c < size; c++) row[c] -= f * pivotRow[c];
+		}
+	}
+
+	return sign;
+}
+
+void matrix::SolveLU(const int* pivots, const float* b, float* x) const
+{
+	//Forward substitution, L*y = P*b. L's diagonal is 1.
+	for (int i = 0; i < size; i++) {
+		float sum = b[pivots[i]];
+		const float* row = m + i*size;
+		for (int c = 0; c < i; c++) sum -= row[c] * x[c];
+		x[i] = sum;
+	}
+
+	//Back substitution, U*x = y, in place
+	for (int i = size - 1; i >= 0; i--) {
+		float sum = x[i];
+		const float* row = m + i*size;
+		for (int c = i + 1; c < size; c++) sum -= row[c] * x[c];
+		x[i] = sum / row[i];
 	}
 }
 
 matrix matrix::DropXY(const int& x, const int& y) const
 {
-	matrix out(size - 1);
+	matrix out(size - 1, mem);
 	//Drops the column by writing certain values twice.
 	//Inefficient and hard to read and probably needs revising
 	for (int ix = 0; ix < size; ix++) for (int iy = 0; iy < size; iy++) {
@@ -85,47 +148,41 @@ matrix matrix::DropXY(const int& x, const int& y) const
 
 matrix matrix::Adjugate() const
 {
-	return Cofactor().Transpose();
+	//One loop, straight from the minors. No cofactor matrix in between.
+	return matrix(Minors().CheckerboardSign().Transpose(), mem);
 }
 
 matrix matrix::Cofactor() const
 {
-	return Minors().CheckerboardSign();
-}
-
-matrix matrix::Transpose() const
-{
-	matrix out(size);
-	for(int x = 0; x < size; x++) for(int y = 0; y < size; y++) out(y,x) = at_c(x,y);
-	return out;
+	return matrix(Minors().CheckerboardSign(), mem);
 }
 
 matrix matrix::Minors() const
 {
-	matrix out(size);
+	matrix out(size, mem);
 	for(int x = 0; x < size; x++) for(int y = 0; y < size; y++) out(x,y) = DropXY(x,y).Determinant();
 	return out;
 }
 
-matrix matrix::CheckerboardSign() const
+matrix::matrix(int _size, std::pmr::memory_resource* mem) :
+	mem{ mem },
+	m{ nullptr },
+	size{ _size }
 {
-	matrix out(size);
-	for(int x = 0; x < size; x++) for(int y = 0; y < size; y++) out(x,y) = ( x%2 != y%2 )? -at_c(x, y) : at_c(x, y);
-	return out;
+	m = _allocate();
+	//No initialization of values; this is done in factory methods
 }
 
-matrix::matrix(int _size) :
-	size{ _size },
-	m{ new float[sq(_size * _size)] }
+matrix::~matrix()
 {
-	//No initialization of values; this is done in factory methods
+	if (m != nullptr) mem->deallocate(m, sizeof(float) * size * size, alignof(float));
 }
 
 //Root of the root of most factory matrices
-matrix matrix::Zero(int _size)
+matrix matrix::Zero(int _size, std::pmr::memory_resource* mem)
 {
 	if (_size < 1) throw std::invalid_argument("Matrices must be at least 1x1!");
-	matrix out(_size);
+	matrix out(_size, mem);
 	for (int x = 0; x < _size; x++) {
 		for (int y = 0; y < _size; y++) {
 			out(x, y) = 0; //Clear garbage data
@@ -135,9 +192,9 @@ matrix matrix::Zero(int _size)
 }
 
 //The root of most factory matrices
-matrix matrix::Identity(int _size)
+matrix matrix::Identity(int _size, std::pmr::memory_resource* mem)
 {
-	matrix out = matrix::Zero(_size);
+	matrix out = matrix::Zero(_size, mem);
 	for (int x = 0; x < _size; x++) {
 		for (int y = 0; y < _size; y++) {
 			out(x, y) = (x==y)?1.0f:0.0f; //Initialize to the identity matrix
@@ -146,45 +203,50 @@ matrix matrix::Identity(int _size)
 	return out;
 }
 
-matrix matrix::Translate(Vector3 vec)
+matrix matrix::Translate(Vector3 vec, std::pmr::memory_resource* mem)
 {
-	matrix out = Identity(4);
+	matrix out = Identity(4, mem);
 	out(3, 0) = vec.x;
 	out(3, 1) = vec.y;
 	out(3, 2) = vec.z;
 	return out;
 }
 
-matrix::matrix(const matrix& cpy) :
-	size(cpy.size),
-	m{ new float[sq(cpy.size)] }
+matrix::matrix(const matrix& cpy) : matrix(cpy, std::pmr::get_default_resource()) {}
+
+matrix::matrix(const matrix& cpy, std::pmr::memory_resource* mem) :
+	matrix(cpy.size, mem)
+{
+	std::copy_n(cpy.m, size * size, m);
+}
+
+matrix::matrix(matrix&& mov) noexcept :
+	mem{ mov.mem },
+	m{ mov.m },
+	size{ mov.size }
 {
-	for (int x = 0; x < size; x++) {
-		for (int y = 0; y < size; y++) {
-			operator()(x, y) = cpy.at_c(x, y);
-		}
-	}
+	mov.m = nullptr;
 }
 
 matrix& matrix::operator=(const matrix& rhs)
 {
-	int least_size = __min(rhs.size, size);
-	for (int x = 0; x < least_size; x++) {
-		for (int y = 0; y < least_size; y++) {
-			operator()(x, y) = rhs.at_c(x, y);
-		}
-	}
+	if (rhs.size != size) throw std::invalid_argument("Can't assign matrices of different sizes!");
+	if (m == nullptr) m = _allocate();
+	if (this != &rhs) std::copy_n(rhs.m, size * size, m);
 	return *this;
 }
 
-matrix matrix::operator*=(matrix& rhs) const
+matrix& matrix::operator=(matrix&& rhs)
 {
-	matrix out = matrix::Zero(size);
-	for (int x = 0; x < size; x++) for (int y = 0; y < size; y++) {
+	if (rhs.size != size) throw std::invalid_argument("Can't assign matrices of different sizes!");
 
-		//Adapted from Matrix.RowColDot
-		for (int i = 0; i < size; i++) out(x, y) += at_c(i, y) + rhs(x, i);
+	//Storage can only change hands if rhs's resource can free ours and vice versa
+	if (mem == rhs.mem || mem->is_equal(*rhs.mem)) std::swap(m, rhs.m);
+	else operator=(rhs);
+	return *this;
+}
 
-	}
-	return out;
+matrix& matrix::operator*=(const matrix& rhs)
+{
+	return *this = *this * rhs;
 }
@@ -0,0 +1,297 @@
+#include "mesh.hpp"
+
+#include "mappedfile.hpp"
+
+#include <cfloat>
+#include <cstring> /* memcpy */
+#include <stdexcept>
+
+static_assert(sizeof(mesh_file_header) == 16, "mesh_file_header is read straight from disk, so it can't have padding");
+
+#pragma region mesh_buffers
+
+mesh_buffers::mesh_buffers() :
+	vertices{ nullptr },
+	indices{ nullptr },
+	vertexCount{ 0 },
+	triangleCount{ 0 }
+{ }
+
+mesh_buffers::~mesh_buffers() = default; //Here, where mapped_file is complete
+
+bool mesh_buffers::validate() const
+{
+	for (size_t i = 0; i < 3 * (size_t)triangleCount; i++) if (indices[i] >= vertexCount) return false;
+	return true;
+}
+
+std::shared_ptr<const mesh_buffers> mesh_buffers::FromArrays(const std::vector<Vector3>& vertices, const std::vector<uint32_t>& indices)
+{
+	if (indices.size() % 3 != 0) throw std::invalid_argument("Indices must come in threes, one per triangle corner!");
+
+	std::shared_ptr<mesh_buffers> out(new mesh_buffers());
+	out->ownedVertices.reserve(3 * vertices.size());
+	for (const Vector3& v : vertices) {
+		out->ownedVertices.push_back(v.x);
+		out->ownedVertices.push_back(v.y);
+		out->ownedVertices.push_back(v.z);
+	}
+	out->ownedIndices = indices;
+
+	out->vertices = out->ownedVertices.data();
+	out->indices = out->ownedIndices.data();
+	out->vertexCount = (uint32_t)vertices.size();
+	out->triangleCount = (uint32_t)(indices.size() / 3);
+	if (!out->validate()) throw std::invalid_argument("Index out of bounds!");
+	return out;
+}
+
+std::shared_ptr<const mesh_buffers> mesh_buffers::Load(const std::string& path)
+{
+	std::shared_ptr<mesh_buffers> out(new mesh_buffers());
+	out->file.reset(new mapped_file(path));
+	const unsigned char* data = out->file->data();
+	const size_t size = out->file->size();
+
+	//Copied out rather than cast, since nothing promises the mapping is aligned for it on every platform
+	mesh_file_header header;
+	if (size < sizeof(header)) throw std::runtime_error(path + " is too small to be a mesh");
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != mesh_file_header::MAGIC) throw std::runtime_error(path + " isn't a .gpm mesh");
+	if (header.version != mesh_file_header::VERSION) throw std::runtime_error(path + " is a .gpm mesh of an unsupported version");
+
+	const uint64_t expected = sizeof(header) + 12 * (uint64_t)header.vertexCount + 12 * (uint64_t)header.triangleCount;
+	if (size < expected) throw std::runtime_error(path + " is truncated");
+
+	//Mappings are page-aligned and every section is a multiple of 4 bytes, so these are aligned too
+	out->vertices = (const float*)(data + sizeof(header));
+	out->indices = (const uint32_t*)(data + sizeof(header) + 12 * (size_t)header.vertexCount);
+	out->vertexCount = header.vertexCount;
+	out->triangleCount = header.triangleCount;
+	if (!out->validate()) throw std::runtime_error(path + " has a triangle pointing past its last vertex");
+	return out;
+}
+
+void mesh_buffers::write_to(std::ostream& out) const
+{
+	if (!out.good()) throw std::invalid_argument("File is not open!");
+
+	mesh_file_header header;
+	header.magic = mesh_file_header::MAGIC;
+	header.version = mesh_file_header::VERSION;
+	header.vertexCount = vertexCount;
+	header.triangleCount = triangleCount;
+
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)vertices, 12 * (std::streamsize)vertexCount);
+	out.write((const char*)indices, 12 * (std::streamsize)triangleCount);
+	out.flush(); //So a full disk shows up here, not when out is closed
+	if (!out.good()) throw std::runtime_error("Couldn't write the whole mesh!");
+}
+
+#pragma endregion mesh_buffers
+
+#pragma region TriangleMesh
+
+TriangleMesh::TriangleMesh(std::shared_ptr<const mesh_buffers> buffers, std::pmr::memory_resource* mem) :
+	color{ Color::FromRGB(1, 0, 0) },
+	buffers{ std::move(buffers) },
+	tree(mem),
+	blocks(mem),
+	blockOf(mem)
+{
+	if (!this->buffers) throw std::invalid_argument("A mesh needs buffers");
+	const mesh_buffers& mesh = *this->buffers;
+	const int count = mesh.GetTriangleCount();
+
+	std::pmr::vector<aabb> primitiveBounds(mem);
+	primitiveBounds.reserve(count);
+	for (int i = 0; i < count; i++) {
+		const uint32_t* tri = mesh.GetTriangle(i);
+		aabb box;
+		for (int c = 0; c < 3; c++) box.Expand(mesh.GetVertex(tri[c]));
+		primitiveBounds.push_back(box);
+	}
+	tree.build(primitiveBounds, ray_packet::WIDTH);
+
+	//Repack every leaf's triangles into blocks, in the form intersect() wants them
+	constexpr int W = ray_packet::WIDTH;
+	blockOf.assign(tree.nodes.size(), -1);
+	for (size_t n = 0; n < tree.nodes.size(); n++) {
+		const bvh_node& node = tree.nodes[n];
+		if (!node.IsLeaf()) continue;
+
+		blockOf[n] = (int)blocks.size();
+		for (int first = 0; first < node.count; first += W) {
+			triangle_block block;
+			memset(&block, 0, sizeof(block));
+			for (int l = 0; l < W; l++) {
+				if (first + l >= node.count) {
+					block.triangle[l] = -1;
+					continue;
+				}
+				const int triangle = tree.indices[node.first + first + l];
+				const uint32_t* tri = mesh.GetTriangle(triangle);
+				const Vector3 v0 = mesh.GetVertex(tri[0]);
+				const Vector3 e1 = Vector3(mesh.GetVertex(tri[1]) - v0);
+				const Vector3 e2 = Vector3(mesh.GetVertex(tri[2]) - v0);
+				block.v0x[l] = v0.x; block.v0y[l] = v0.y; block.v0z[l] = v0.z;
+				block.e1x[l] = e1.x; block.e1y[l] = e1.y; block.e1z[l] = e1.z;
+				block.e2x[l] = e2.x; block.e2y[l] = e2.y; block.e2z[l] = e2.z;
+				block.triangle[l] = triangle;
+			}
+			blocks.push_back(block);
+		}
+	}
+}
+
+int TriangleMesh::intersect(const int& b, const Ray& ray, const float& t_min, const float& t_max, float* t) const
+{
+	//Moller-Trumbore, one triangle per lane
+	const triangle_block& block = blocks[b];
+	const pfloat dx(ray.direction.x), dy(ray.direction.y), dz(ray.direction.z);
+	const pfloat e1x = pfloat::Load(block.e1x), e1y = pfloat::Load(block.e1y), e1z = pfloat::Load(block.e1z);
+	const pfloat e2x = pfloat::Load(block.e2x), e2y = pfloat::Load(block.e2y), e2z = pfloat::Load(block.e2z);
+
+	//p = d x e2
+	const pfloat px = dy*e2z - dz*e2y;
+	const pfloat py = dz*e2x - dx*e2z;
+	const pfloat pz = dx*e2y - dy*e2x;
+	const pfloat det = e1x*px + e1y*py + e1z*pz;
+	const pfloat zero(0.0f), one(1.0f);
+	const pfloat inv = one / det;
+
+	//s = o - v0, q = s x e1
+	const pfloat sx = pfloat(ray.origin.x) - pfloat::Load(block.v0x);
+	const pfloat sy = pfloat(ray.origin.y) - pfloat::Load(block.v0y);
+	const pfloat sz = pfloat(ray.origin.z) - pfloat::Load(block.v0z);
+	const pfloat qx = sy*e1z - sz*e1y;
+	const pfloat qy = sz*e1x - sx*e1z;
+	const pfloat qz = sx*e1y - sy*e1x;
+
+	//Barycentrics and distance. Comparisons are ordered, so NaNs (from degenerate or spare lanes) miss.
+	const pfloat u = (sx*px + sy*py + sz*pz) * inv;
+	const pfloat v = (dx*qx + dy*qy + dz*qz) * inv;
+	const pfloat dist = (e2x*qx + e2y*qy + e2z*qz) * inv;
+	const pmask hit = ((det > zero) | (det < zero)) & (u >= zero) & (v >= zero) & (u + v <= one) & (dist > pfloat(t_min)) & (dist < pfloat(t_max));
+
+	dist.Store(t);
+	return hit.Bits();
+}
+
+void TriangleMesh::makeHit(const int& triangle, const Ray& ray, const float& t, trace_hit& out) const
+{
+	//Geometric normal, wound counter-clockwise
+	const uint32_t* tri = buffers->GetTriangle(triangle);
+	const Vector3 v0 = buffers->GetVertex(tri[0]);
+	const Vector3 e1 = Vector3(buffers->GetVertex(tri[1]) - v0);
+	const Vector3 e2 = Vector3(buffers->GetVertex(tri[2]) - v0);
+
+	out.position = ray.GetByT(t);
+	out.normal = e1.Cross(e2).Normalize();
+	out.color = color;
+	out.t = t;
+}
+
+void TriangleMesh::trace(const Ray& ray, hit_buffer& out)
+{
+	alignas(32) float t[ray_packet::WIDTH];
+	tree.traverse(ray, 0, FLT_MAX, [&](const bvh_node& leaf) {
+		const int first = blockAt(leaf);
+		for (int b = first; b < first + (leaf.count + ray_packet::WIDTH - 1) / ray_packet::WIDTH; b++) {
+			int hits = intersect(b, ray, 0, FLT_MAX, t);
+			for (int l = 0; hits != 0; l++, hits >>= 1) {
+				if (!(hits & 1)) continue;
+				out.emplace_back();
+				makeHit(blocks[b].triangle[l], ray, t[l], out.back());
+			}
+		}
+		return false;
+	});
+}
+
+bool TriangleMesh::trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out)
+{
+	//Only the winner gets a hit record
+	float closest = t_max;
+	int best = -1;
+	alignas(32) float t[ray_packet::WIDTH];
+
+	tree.traverse(ray, t_min, closest, [&](const bvh_node& leaf) {
+		const int first = blockAt(leaf);
+		for (int b = first; b < first + (leaf.count + ray_packet::WIDTH - 1) / ray_packet::WIDTH; b++) {
+			int hits = intersect(b, ray, t_min, closest, t);
+			for (int l = 0; hits != 0; l++, hits >>= 1) {
+				if ((hits & 1) && t[l] < closest) {
+					closest = t[l];
+					best = blocks[b].triangle[l];
+				}
+			}
+		}
+		return false;
+	});
+
+	if (best < 0) return false;
+	makeHit(best, ray, closest, out);
+	return true;
+}
+
+bool TriangleMesh::trace_any(const Ray& ray, const float& t_min, const float& t_max)
+{
+	bool found = false;
+	alignas(32) float t[ray_packet::WIDTH];
+
+	tree.traverse(ray, t_min, t_max, [&](const bvh_node& leaf) {
+		const int first = blockAt(leaf);
+		for (int b = first; b < first + (leaf.count + ray_packet::WIDTH - 1) / ray_packet::WIDTH; b++) {
+			if (intersect(b, ray, t_min, t_max, t) != 0) return found = true;
+		}
+		return false;
+	});
+
+	return found;
+}
+
+void TriangleMesh::trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes)
+{
+	//The tree is walked by the whole packet, but each leaf is already a SIMD test of its
+	//own, across triangles, so rays take their turn at it one lane at a time
+	alignas(32) float t[ray_packet::WIDTH];
+
+	tree.traverse(rays, t_min, out.t_max, lanes, [&](const bvh_node& leaf, const int& active) {
+		const int first = blockAt(leaf);
+		const int last = first + (leaf.count + ray_packet::WIDTH - 1) / ray_packet::WIDTH;
+		for (int r = 0; r < ray_packet::WIDTH; r++) {
+			if (!((active >> r) & 1)) continue;
+
+			const Ray ray = rays.GetRay(r);
+			int best = -1;
+			for (int b = first; b < last; b++) {
+				int hits = intersect(b, ray, t_min, out.t_max[r], t);
+				for (int l = 0; hits != 0; l++, hits >>= 1) {
+					if ((hits & 1) && t[l] < out.t_max[r]) {
+						out.t_max[r] = t[l];
+						best = blocks[b].triangle[l];
+					}
+				}
+			}
+
+			if (best >= 0) {
+				makeHit(best, ray, out.t_max[r], out.hits[r]);
+				out.mask |= 1 << r;
+			}
+		}
+	});
+}
+
+aabb TriangleMesh::bounds() const
+{
+	return tree.GetBounds();
+}
+
+Vector3 TriangleMesh::normal_at(const Vector3& /*pos*/)
+{
+	throw std::logic_error("TriangleMesh normals depend on which triangle was hit; use trace_hit::normal instead");
+}
+
+#pragma endregion TriangleMesh
@@ -1,18 +1,82 @@
 #include "raytrace.hpp"
 
+#include <cmath>
 #include "moremath.inl"
 
-#include <iostream>
+#pragma region Traceable
+
+//Scratch hits for the default implementations. Objects rarely have more than a couple
+//of hits per ray, so these usually never leave the stack.
+struct local_hit_buffer final {
+	static constexpr int CAPACITY = 16;
+	alignas(trace_hit) unsigned char storage[CAPACITY * sizeof(trace_hit)];
+	std::pmr::monotonic_buffer_resource mem{ storage, sizeof(storage) };
+	hit_buffer hits{ &mem };
+
+	local_hit_buffer() { hits.reserve(CAPACITY); }
+};
+
+std::vector<trace_hit> Traceable::trace(const Ray& ray)
+{
+	local_hit_buffer local;
+	trace(ray, local.hits);
+	return std::vector<trace_hit>(local.hits.begin(), local.hits.end());
+}
+
+void Traceable::trace(const Ray& ray, hit_buffer& out)
+{
+	std::vector<trace_hit> hits = trace(ray);
+	out.insert(out.end(), hits.begin(), hits.end());
+}
+
+bool Traceable::trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out)
+{
+	local_hit_buffer local;
+	trace(ray, local.hits);
+
+	bool found = false;
+	float closest = t_max;
+	for (const trace_hit& hit : local.hits) {
+		if (hit.t > t_min && hit.t < closest) {
+			out = hit;
+			closest = hit.t;
+			found = true;
+		}
+	}
+	return found;
+}
+
+bool Traceable::trace_any(const Ray& ray, const float& t_min, const float& t_max)
+{
+	local_hit_buffer local;
+	trace(ray, local.hits);
+
+	for (const trace_hit& hit : local.hits) if (hit.t > t_min && hit.t < t_max) return true;
+	return false;
+}
+
+void Traceable::trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes)
+{
+	for (int i = 0; i < ray_packet::WIDTH; i++) {
+		if (!((lanes >> i) & 1)) continue;
+		if (trace_closest(rays.GetRay(i), t_min, out.t_max[i], out.hits[i])) {
+			out.t_max[i] = out.hits[i].t;
+			out.mask |= 1 << i;
+		}
+	}
+}
+
+#pragma endregion Traceable
+
+#pragma region Sphere
 
 Sphere::Sphere(const Vector3& _position, const float& _radius) :
-	_ltw(matrix::Translate(_position)), //Crappy way of doing this, but I don't have another (easy) option.
+	_transform(mat4::Translate(_position)), //Crappy way of doing this, but I don't have another (easy) option.
 	radius(_radius)
 {}
 
-std::vector<trace_hit> Sphere::trace(const Ray& ray)
+void Sphere::trace(const Ray& ray, hit_buffer& out)
 {
-	std::vector<trace_hit> out;
-
 	//Surprisingly, it's less time consuming to implement Matrices here and now
 	//than it is to sum three trinomial squares then plug it into the quadratic
 	//formula to find t.
@@ -20,16 +84,14 @@ std::vector<trace_hit> Sphere::trace(const Ray& ray)
 	//Or so I thought at 2am. Anyway I have some notes in my notebook that I don't
 	//feel like typing up, if you want to see them I'll post a screenshot.
 
-	matrix _wtl = _ltw.Inverse();
-	Ray local_ray = ray * _wtl;
+	Ray local_ray = ray * _transform.GetWorldToLocal();
 	Vector3& o = local_ray.origin;
 	Vector3& d = local_ray.direction;
 
-	quadratic solve_for_t(sq(d.x)+sq(d.y)+sq(d.z), 2*(o.x*d.x+o.y*d.y+o.z*d.z), sq(o.x)+sq(o.y)+sq(o.z)+sq(radius));
+	quadratic solve_for_t(sq(d.x)+sq(d.y)+sq(d.z), 2*(o.x*d.x+o.y*d.y+o.z*d.z), sq(o.x)+sq(o.y)+sq(o.z)-sq(radius));
 
-	if (solve_for_t.getSolutionCount() > 0) {
-		std::cout << solve_for_t.getSolutionCount() << std::endl;
-	}
+	//Transforms are affine, so t means the same thing in local and world space.
+	//Hits are reported in world space.
 
 	//INTENTIONAL CASCADE OF PROGRAM FLOW
 	switch (solve_for_t.getSolutionCount()) {
@@ -38,8 +100,8 @@ std::vector<trace_hit> Sphere::trace(const Ray& ray)
 			//Fetch solution #1 if it exists
 			float t = solve_for_t.getSolution(1);
 			if (t > 0) { //Prevent rendering stuff behind the camera!
-				Vector3 s1 = local_ray.GetByT(t);
-				out.push_back(trace_hit(s1, normal_at(s1), Color::FromRGB(1, 0, 0)));
+				Vector3 s1 = ray.GetByT(t);
+				out.push_back(trace_hit(s1, normal_at(s1), Color::FromRGB(1, 0, 0), t));
 			}
 		}
 	case 1:
@@ -47,17 +109,130 @@ std::vector<trace_hit> Sphere::trace(const Ray& ray)
 			//Fetch solution #0 if it exists
 			float t = solve_for_t.getSolution(0);
 			if (t > 0) { //Prevent rendering stuff behind the camera!
-				Vector3 s0 = local_ray.GetByT(solve_for_t.getSolution(0));
-				out.push_back(trace_hit(s0, normal_at(s0), Color::FromRGB(1, 0, 0)));
+				Vector3 s0 = ray.GetByT(t);
+				out.push_back(trace_hit(s0, normal_at(s0), Color::FromRGB(1, 0, 0), t));
 			}
 		}
 	}
+}
 
-	return out;
+bool Sphere::intersect(const Ray& ray, const float& t_min, const float& t_max, float& t) const
+{
+	//Same quadratic as trace(), minus the exceptions and hit records
+	Ray local_ray = ray * _transform.GetWorldToLocal();
+	const Vector3& o = local_ray.origin;
+	const Vector3& d = local_ray.direction;
+
+	const float a = d.Dot(d);
+	const float b = 2 * o.Dot(d);
+	const float c = o.Dot(o) - sq(radius);
+
+	//Comparisons are written so NaN counts as a miss (trace_packet does the same)
+	const float disc = sq(b) - 4*a*c;
+	if (!(disc >= 0)) return false;
+	const float root = sqrtf(disc);
+
+	//Near root first, so the first one in range is the closest
+	float candidate = (-b - root) / 2 / a;
+	if (!(candidate > t_min && candidate < t_max)) {
+		candidate = (-b + root) / 2 / a;
+		if (!(candidate > t_min && candidate < t_max)) return false;
+	}
+
+	t = candidate;
+	return true;
+}
+
+bool Sphere::trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out)
+{
+	float t;
+	if (!intersect(ray, t_min, t_max, t)) return false;
+
+	Vector3 pos = ray.GetByT(t);
+	out.position = pos;
+	out.normal = normal_at(pos);
+	out.color = Color::FromRGB(1, 0, 0);
+	out.t = t;
+	return true;
+}
+
+bool Sphere::trace_any(const Ray& ray, const float& t_min, const float& t_max)
+{
+	float t;
+	return intersect(ray, t_min, t_max, t);
+}
+
+void Sphere::trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes)
+{
+	//intersect(), one lane per ray. Every step mirrors the scalar version's
+	//operation order (including mat4::TransformPoint and Vector3::Dot), so
+	//each lane gets exactly the t the scalar path would.
+	const mat4& w = _transform.GetWorldToLocal();
+
+	const pfloat wox = pfloat::Load(rays.ox), woy = pfloat::Load(rays.oy), woz = pfloat::Load(rays.oz);
+	const pfloat wdx = pfloat::Load(rays.dx), wdy = pfloat::Load(rays.dy), wdz = pfloat::Load(rays.dz);
+
+	const pfloat ox = pfloat(w.at_c(0, 0))*wox + pfloat(w.at_c(1, 0))*woy + pfloat(w.at_c(2, 0))*woz + pfloat(w.at_c(3, 0));
+	const pfloat oy = pfloat(w.at_c(0, 1))*wox + pfloat(w.at_c(1, 1))*woy + pfloat(w.at_c(2, 1))*woz + pfloat(w.at_c(3, 1));
+	const pfloat oz = pfloat(w.at_c(0, 2))*wox + pfloat(w.at_c(1, 2))*woy + pfloat(w.at_c(2, 2))*woz + pfloat(w.at_c(3, 2));
+	const pfloat dx = pfloat(w.at_c(0, 0))*wdx + pfloat(w.at_c(1, 0))*wdy + pfloat(w.at_c(2, 0))*wdz;
+	const pfloat dy = pfloat(w.at_c(0, 1))*wdx + pfloat(w.at_c(1, 1))*wdy + pfloat(w.at_c(2, 1))*wdz;
+	const pfloat dz = pfloat(w.at_c(0, 2))*wdx + pfloat(w.at_c(1, 2))*wdy + pfloat(w.at_c(2, 2))*wdz;
+
+	const pfloat a = dx*dx + dy*dy + dz*dz;
+	const pfloat b = pfloat(2) * (ox*dx + oy*dy + oz*dz);
+	const pfloat c = (ox*ox + oy*oy + oz*oz) - pfloat(sq(radius));
+
+	const pfloat disc = b*b - pfloat(4)*a*c;
+	const pmask real = disc >= pfloat(0);
+	const pfloat root = pfloat::Sqrt(disc);
+
+	const pfloat lo = pfloat(t_min);
+	const pfloat hi = pfloat::Load(out.t_max);
+	const pfloat t0 = (-b - root) / pfloat(2) / a;
+	const pfloat t1 = (-b + root) / pfloat(2) / a;
+	const pmask in0 = (t0 > lo) & (t0 < hi);
+	const pmask in1 = (t1 > lo) & (t1 < hi);
+
+	//Near root if it's in range, otherwise far root
+	alignas(32) float t[ray_packet::WIDTH];
+	pfloat::Select(in0, t0, t1).Store(t);
+	int hitLanes = (real & (in0 | in1)).Bits() & lanes;
+
+	//Hit records are rare compared to tests, so build them one lane at a time
+	for (int i = 0; hitLanes != 0; i++, hitLanes >>= 1) {
+		if (!(hitLanes & 1)) continue;
+
+		Vector3 pos = rays.GetRay(i).GetByT(t[i]);
+		out.hits[i].position = pos;
+		out.hits[i].normal = normal_at(pos);
+		out.hits[i].color = Color::FromRGB(1, 0, 0);
+		out.hits[i].t = t[i];
+		out.t_max[i] = t[i];
+		out.mask |= 1 << i;
+	}
 }
 
 Vector3 Sphere::normal_at(const Vector3& pos)
 {
-	Vector3 pos_diff = pos - Vector3(_ltw(3, 0), _ltw(3, 1), _ltw(3, 2));
-	return pos_diff.Normalize();
-}
\ No newline at end of file
+	//On a sphere, the local-space normal is just the local-space position
+	Vector3 local_pos = _transform.GetWorldToLocal().TransformPoint(pos);
+	return _transform.TransformNormal(local_pos);
+}
+
+aabb Sphere::bounds() const
+{
+	//Transform the corners of the local-space box, so this holds even if the transform isn't a pure translation
+	aabb out;
+	for (int i = 0; i < 8; i++) {
+		Vector3 corner(
+			(i & 1) ? radius : -radius,
+			(i & 2) ? radius : -radius,
+			(i & 4) ? radius : -radius
+		);
+		out.Expand(_transform.GetLocalToWorld().TransformPoint(corner));
+	}
+	return out;
+}
+
+#pragma endregion Sphere
@@ -0,0 +1,106 @@
+#include "scanlinewriter.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+ScanlineWriter::ScanlineWriter(std::ostream& out, const int& width, const int& height, const float& color_space, const image_format& format, const int& windowRows) :
+	width{ width },
+	height{ height },
+	color_space{ color_space },
+	format{ format },
+	windowRows{ std::max(1, std::min(windowRows, height)) },
+	out{ &out },
+	nextToWrite{ 0 },
+	cancelled{ false }
+{
+	if (width <= 0 || height <= 0) throw std::invalid_argument("Image must be at least 1x1!");
+	if (!out.good()) throw std::invalid_argument("File is not open!");
+
+	Image::write_header(out, width, height, color_space, format);
+
+	rows.resize(this->windowRows * width);
+	ready.resize(this->windowRows, 0);
+	writer = std::thread(&ScanlineWriter::writerMain, this);
+}
+
+ScanlineWriter::~ScanlineWriter()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		cancelled = true;
+	}
+	rowReady.notify_all();
+	slotFree.notify_all();
+	if (writer.joinable()) writer.join();
+}
+
+Color* ScanlineWriter::acquire(const int& y)
+{
+	if (y < 0 || y >= height) throw std::invalid_argument("Row out of bounds!");
+
+	std::unique_lock<std::mutex> guard(lock);
+	slotFree.wait(guard, [&]() { return y < nextToWrite + windowRows || error || cancelled; });
+	if (error) std::rethrow_exception(error);
+	if (cancelled) throw std::logic_error("ScanlineWriter already finished");
+
+	return rows.data() + (y % windowRows) * width;
+}
+
+void ScanlineWriter::submit(const int& y)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		ready[y % windowRows] = 1;
+	}
+	rowReady.notify_one();
+}
+
+void ScanlineWriter::finish()
+{
+	if (writer.joinable()) writer.join();
+	out->flush();
+
+	//Anyone still waiting in acquire has nothing left to wait for
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		cancelled = true;
+	}
+	slotFree.notify_all();
+
+	if (error) std::rethrow_exception(error);
+}
+
+void ScanlineWriter::writerMain()
+{
+	std::vector<unsigned char> scratch;
+	try {
+		while (true) {
+			Color* row;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				if (nextToWrite >= height) return;
+				rowReady.wait(guard, [&]() { return ready[nextToWrite % windowRows] || cancelled; });
+				if (!ready[nextToWrite % windowRows]) return; //Cancelled
+				row = rows.data() + (nextToWrite % windowRows) * width;
+			}
+
+			//Slot can't be reacquired until nextToWrite moves past it, so no lock needed while encoding
+			Image::write_pixels(*out, row, width, color_space, format, scratch);
+			if (!out->good()) throw std::runtime_error("Failed writing image row");
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				ready[nextToWrite % windowRows] = 0;
+				nextToWrite++;
+			}
+			slotFree.notify_all();
+		}
+	}
+	catch (...) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			error = std::current_exception();
+		}
+		slotFree.notify_all();
+	}
+}
@@ -0,0 +1,422 @@
+#include "scene.hpp"
+
+#include "image.hpp"
+#include "mappedfile.hpp"
+#include "moremath.inl"
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring> /* memcpy */
+#include <numeric>
+#include <stdexcept>
+
+//Everything below is read straight from disk, so none of it can have padding
+static_assert(sizeof(scene_file_header) == 48, "scene_file_header must be tightly packed");
+static_assert(sizeof(scene_sphere) == 24, "scene_sphere must be tightly packed");
+static_assert(sizeof(scene_node) == 32, "scene_node must be tightly packed");
+static_assert(sizeof(affine) == 48, "affine must be tightly packed");
+
+scene_settings Scene::DefaultSettings()
+{
+	scene_settings out;
+	out.width = 16*20;
+	out.height = 9*20;
+	out.colorSpace = Image::DEFAULT_COLOR_SPACE;
+	out.fov = 75.0f*DEG2RAD;
+	return out;
+}
+
+Scene::Scene(int maxLeafSize, std::pmr::memory_resource* mem) :
+	settings{ DefaultSettings() },
+	spheres{ nullptr },
+	transforms{ nullptr },
+	sphereCount{ 0 },
+	transformCount{ 0 },
+	ownedSpheres(mem),
+	ownedTransforms(mem),
+	materials(mem),
+	tree(mem),
+	maxLeafSize{ maxLeafSize },
+	stale{ false }
+{ }
+
+Scene::~Scene() = default; //Here, where mapped_file is complete
+
+#pragma region Building
+
+void Scene::detach()
+{
+	if (file == nullptr) return;
+	ownedSpheres.assign(spheres, spheres + sphereCount);
+	ownedTransforms.assign(transforms, transforms + transformCount);
+	spheres = ownedSpheres.data();
+	transforms = ownedTransforms.data();
+	file.reset();
+}
+
+int Scene::addMaterial(const Color& color)
+{
+	materials.push_back(color);
+	return (int)materials.size() - 1;
+}
+
+void Scene::add(const Vector3& center, const float& radius, const int& material)
+{
+	if (!(radius > 0)) throw std::invalid_argument("Sphere radius must be positive!");
+	if (material != NO_MATERIAL && (material < 0 || material >= (int)materials.size())) throw std::invalid_argument("No such material!");
+
+	detach();
+	ownedSpheres.push_back({ center.x, center.y, center.z, radius, material, NO_TRANSFORM });
+	spheres = ownedSpheres.data();
+	sphereCount = (int)ownedSpheres.size();
+	stale = true;
+}
+
+void Scene::add(const mat4& localToWorld, const int& material)
+{
+	if (material != NO_MATERIAL && (material < 0 || material >= (int)materials.size())) throw std::invalid_argument("No such material!");
+
+	detach();
+	ownedTransforms.push_back(affine(localToWorld.Inverse()));
+	transforms = ownedTransforms.data();
+	transformCount = (int)ownedTransforms.size();
+
+	ownedSpheres.push_back({ 0, 0, 0, 1, material, transformCount - 1 });
+	spheres = ownedSpheres.data();
+	sphereCount = (int)ownedSpheres.size();
+	stale = true;
+}
+
+void Scene::reserve(const int& count)
+{
+	detach();
+	ownedSpheres.reserve(count);
+	spheres = ownedSpheres.data();
+}
+
+void Scene::rebuild()
+{
+	detach();
+
+	//Transformed spheres are bounded by their local box's corners, moved out into world space
+	std::pmr::vector<affine> localToWorld(tree.GetResource());
+	localToWorld.reserve(transformCount);
+	for (int i = 0; i < transformCount; i++) localToWorld.push_back(affine(transforms[i].ToMat4().Inverse()));
+
+	std::pmr::vector<aabb> primitiveBounds(tree.GetResource());
+	primitiveBounds.reserve(sphereCount);
+	for (int i = 0; i < sphereCount; i++) {
+		const scene_sphere& s = spheres[i];
+		const Vector3 lo(s.x - s.radius, s.y - s.radius, s.z - s.radius);
+		const Vector3 hi(s.x + s.radius, s.y + s.radius, s.z + s.radius);
+		if (s.transform == NO_TRANSFORM) {
+			primitiveBounds.push_back(aabb(lo, hi));
+			continue;
+		}
+
+		aabb world;
+		for (int c = 0; c < 8; c++) {
+			world.Expand(localToWorld[s.transform].TransformPoint(Vector3(
+				(c & 1) ? hi.x : lo.x,
+				(c & 2) ? hi.y : lo.y,
+				(c & 4) ? hi.z : lo.z
+			)));
+		}
+		primitiveBounds.push_back(world);
+	}
+	tree.build(primitiveBounds, maxLeafSize);
+
+	//Spheres move into leaf order, so every leaf is a contiguous run and a saved tree needs no indices
+	std::pmr::vector<scene_sphere> ordered(ownedSpheres.get_allocator());
+	ordered.reserve(sphereCount);
+	for (int i = 0; i < sphereCount; i++) ordered.push_back(ownedSpheres[tree.indices[i]]);
+	ownedSpheres.swap(ordered);
+	spheres = ownedSpheres.data();
+	std::iota(tree.indices.begin(), tree.indices.end(), 0);
+
+	stale = false;
+}
+
+#pragma endregion Building
+
+#pragma region Files
+
+std::unique_ptr<Scene> Scene::Load(const std::string& path, std::pmr::memory_resource* mem)
+{
+	std::unique_ptr<Scene> scene(new Scene(bvh_tree::DEFAULT_LEAF_SIZE, mem));
+	scene->file.reset(new mapped_file(path));
+	const unsigned char* data = scene->file->data();
+	const size_t size = scene->file->size();
+
+	//Copied out rather than cast, since nothing promises the mapping is aligned for it on every platform
+	scene_file_header header;
+	if (size < sizeof(header)) throw std::runtime_error(path + " is too small to be a scene");
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != scene_file_header::MAGIC) throw std::runtime_error(path + " isn't a .gps scene");
+	if (header.version != scene_file_header::VERSION) throw std::runtime_error(path + " is a .gps scene of an unsupported version");
+	if ((header.flags & ~scene_file_header::FLAG_TREE) != 0) throw std::runtime_error(path + " uses features this version doesn't support");
+
+	const bool cached = (header.flags & scene_file_header::FLAG_TREE) != 0;
+	if (header.sphereCount > INT_MAX || header.transformCount > INT_MAX || header.materialCount > INT_MAX || header.nodeCount > INT_MAX) throw std::runtime_error(path + " is too big");
+	if (!cached && header.nodeCount != 0) throw std::runtime_error(path + " has a tree it says it doesn't");
+
+	const uint64_t materialsAt  = sizeof(header);
+	const uint64_t transformsAt = materialsAt  + 4 * sizeof(float) * (uint64_t)header.materialCount;
+	const uint64_t spheresAt    = transformsAt + sizeof(affine) * (uint64_t)header.transformCount;
+	const uint64_t nodesAt      = spheresAt    + sizeof(scene_sphere) * (uint64_t)header.sphereCount;
+	const uint64_t expected     = nodesAt      + sizeof(scene_node) * (uint64_t)header.nodeCount;
+	if (size < expected) throw std::runtime_error(path + " is truncated");
+
+	const scene_settings& settings = header.settings;
+	if (settings.width <= 0 || settings.height <= 0 || !(settings.colorSpace > 0) || !(settings.fov > 0 && settings.fov < PI)) throw std::runtime_error(path + " has bad render settings");
+	scene->settings = settings;
+	if (header.maxLeafSize > 0 && header.maxLeafSize <= INT_MAX) scene->maxLeafSize = (int)header.maxLeafSize;
+
+	//Materials are tiny, and Color has a layout of its own, so they're the one thing converted
+	scene->materials.reserve(header.materialCount);
+	for (uint32_t i = 0; i < header.materialCount; i++) {
+		float rgbs[4];
+		memcpy(rgbs, data + materialsAt + sizeof(rgbs) * i, sizeof(rgbs));
+		scene->materials.push_back(Color::FromRGB(rgbs[0], rgbs[1], rgbs[2], rgbs[3]));
+	}
+
+	//Mappings are page-aligned and every section is a multiple of 4 bytes, so these are aligned too
+	scene->transforms = (const affine*)(data + transformsAt);
+	scene->transformCount = (int)header.transformCount;
+	scene->spheres = (const scene_sphere*)(data + spheresAt);
+	scene->sphereCount = (int)header.sphereCount;
+
+	//Every index gets checked once here, so tracing never has to
+	for (int i = 0; i < scene->sphereCount; i++) {
+		const scene_sphere& s = scene->spheres[i];
+		if (!(s.radius > 0)
+			|| s.material  < NO_MATERIAL  || s.material  >= (int)header.materialCount
+			|| s.transform < NO_TRANSFORM || s.transform >= (int)header.transformCount) throw std::runtime_error(path + " has a bad sphere");
+	}
+
+	if (!cached) {
+		scene->rebuild(); //Copies everything out of the file, so it's unmapped after this
+		return scene;
+	}
+
+	std::pmr::vector<bvh_node> nodes(header.nodeCount, mem);
+	for (uint32_t i = 0; i < header.nodeCount; i++) {
+		scene_node n;
+		memcpy(&n, data + nodesAt + sizeof(n) * i, sizeof(n));
+		nodes[i].box = aabb(Vector3(n.boxMin[0], n.boxMin[1], n.boxMin[2]), Vector3(n.boxMax[0], n.boxMax[1], n.boxMax[2]));
+		nodes[i].first = n.first;
+		nodes[i].count = n.count;
+	}
+	try {
+		scene->tree.assign(std::move(nodes), scene->sphereCount);
+	}
+	catch (const std::invalid_argument& e) {
+		throw std::runtime_error(path + " has a corrupt tree: " + e.what());
+	}
+	return scene;
+}
+
+void Scene::write_to(std::ostream& out, const scene_format& format) const
+{
+	const bool cached = format == scene_format::CACHED;
+	if (cached && stale) throw std::logic_error("Call rebuild() before saving a cached scene");
+	if (!out.good()) throw std::invalid_argument("File is not open!");
+
+	scene_file_header header;
+	header.magic = scene_file_header::MAGIC;
+	header.version = scene_file_header::VERSION;
+	header.flags = cached ? scene_file_header::FLAG_TREE : 0;
+	header.maxLeafSize = (uint32_t)maxLeafSize;
+	header.materialCount = (uint32_t)materials.size();
+	header.transformCount = (uint32_t)transformCount;
+	header.sphereCount = (uint32_t)sphereCount;
+	header.nodeCount = cached ? (uint32_t)tree.nodes.size() : 0;
+	header.settings = settings;
+	out.write((const char*)&header, sizeof(header));
+
+	for (const Color& c : materials) {
+		const float rgbs[4] = { c.r, c.g, c.b, c.GetScale() };
+		out.write((const char*)rgbs, sizeof(rgbs));
+	}
+	out.write((const char*)transforms, sizeof(affine) * (std::streamsize)transformCount);
+	out.write((const char*)spheres, sizeof(scene_sphere) * (std::streamsize)sphereCount);
+
+	if (cached) for (const bvh_node& node : tree.nodes) {
+		const scene_node n = {
+			{ node.box.min.x, node.box.min.y, node.box.min.z },
+			{ node.box.max.x, node.box.max.y, node.box.max.z },
+			node.first,
+			node.count
+		};
+		out.write((const char*)&n, sizeof(n));
+	}
+
+	out.flush(); //So a full disk shows up here, not when out is closed
+	if (!out.good()) throw std::runtime_error("Couldn't write the whole scene!");
+}
+
+#pragma endregion Files
+
+#pragma region Tracing
+
+bool Scene::solve(const scene_sphere& s, const Ray& local, float& t0, float& t1)
+{
+	//Same quadratic as SphereSet::solve, op for op, so trace_packet can match it exactly
+	const float ox = local.origin.x - s.x, oy = local.origin.y - s.y, oz = local.origin.z - s.z;
+	const float dx = local.direction.x, dy = local.direction.y, dz = local.direction.z;
+
+	const float a = dx*dx + dy*dy + dz*dz;
+	const float b = 2 * (ox*dx + oy*dy + oz*dz);
+	const float c = (ox*ox + oy*oy + oz*oz) - s.radius*s.radius;
+
+	const float disc = b*b - 4*a*c;
+	if (!(disc >= 0)) return false;
+	const float root = sqrtf(disc);
+	t0 = (-b - root) / 2 / a;
+	t1 = (-b + root) / 2 / a;
+	return true;
+}
+
+trace_hit Scene::makeHit(const int& i, const Ray& ray, const float& t) const
+{
+	const scene_sphere& s = spheres[i];
+	const Vector3 center(s.x, s.y, s.z);
+	const Vector3 pos = ray.GetByT(t);
+	const Color color = s.material == NO_MATERIAL ? Color::FromRGB(1, 0, 0) : materials[s.material];
+	if (s.transform == NO_TRANSFORM) return trace_hit(pos, Vector3(pos - center).Normalize(), color, t);
+
+	//Normals go through the inverse transpose of localToWorld, which is just worldToLocal transposed
+	const affine& w = transforms[s.transform];
+	const Vector3 local = w.TransformPoint(pos);
+	return trace_hit(pos, w.TransposeTransformVector(Vector3(local - center)).Normalize(), color, t);
+}
+
+void Scene::trace(const Ray& ray, hit_buffer& out)
+{
+	tree.traverse(ray, 0, FLT_MAX, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			float t0, t1;
+			if (!solve(spheres[i], toLocal(spheres[i], ray), t0, t1)) continue;
+			//Prevent rendering stuff behind the camera, same as Sphere::trace
+			if (t0 > 0) out.push_back(makeHit(i, ray, t0));
+			if (t1 > 0 && t1 != t0) out.push_back(makeHit(i, ray, t1));
+		}
+		return false;
+	});
+}
+
+bool Scene::trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out)
+{
+	//Only the winner gets a hit record
+	float closest = t_max;
+	int closestIndex = -1;
+
+	tree.traverse(ray, t_min, closest, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			float t0, t1;
+			if (!solve(spheres[i], toLocal(spheres[i], ray), t0, t1)) continue;
+
+			//Near root if it's in range, otherwise far root
+			const float t = (t0 > t_min && t0 < closest) ? t0 : t1;
+			if (t > t_min && t < closest) {
+				closest = t;
+				closestIndex = i;
+			}
+		}
+		return false;
+	});
+
+	if (closestIndex < 0) return false;
+	out = makeHit(closestIndex, ray, closest);
+	return true;
+}
+
+bool Scene::trace_any(const Ray& ray, const float& t_min, const float& t_max)
+{
+	bool found = false;
+
+	tree.traverse(ray, t_min, t_max, [&](const bvh_node& leaf) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			float t0, t1;
+			if (!solve(spheres[i], toLocal(spheres[i], ray), t0, t1)) continue;
+			if ((t0 > t_min && t0 < t_max) || (t1 > t_min && t1 < t_max)) return found = true;
+		}
+		return false;
+	});
+
+	return found;
+}
+
+void Scene::trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes)
+{
+	//The packet is the vector and spheres are the loop, same as SphereSet. Per lane,
+	//every op matches toLocal and solve(), so results agree with trace_closest.
+	const pfloat wox = pfloat::Load(rays.ox), woy = pfloat::Load(rays.oy), woz = pfloat::Load(rays.oz);
+	const pfloat wdx = pfloat::Load(rays.dx), wdy = pfloat::Load(rays.dy), wdz = pfloat::Load(rays.dz);
+	const pfloat lo = pfloat(t_min);
+
+	int closestIndex[ray_packet::WIDTH];
+	for (int i = 0; i < ray_packet::WIDTH; i++) closestIndex[i] = -1;
+
+	tree.traverse(rays, t_min, out.t_max, lanes, [&](const bvh_node& leaf, const int& active) {
+		for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+			const scene_sphere& s = spheres[i];
+
+			pfloat ox = wox, oy = woy, oz = woz, dx = wdx, dy = wdy, dz = wdz;
+			if (s.transform != NO_TRANSFORM) {
+				const float* w = transforms[s.transform].m;
+				ox = pfloat(w[0])*wox + pfloat(w[1])*woy + pfloat(w[ 2])*woz + pfloat(w[ 3]);
+				oy = pfloat(w[4])*wox + pfloat(w[5])*woy + pfloat(w[ 6])*woz + pfloat(w[ 7]);
+				oz = pfloat(w[8])*wox + pfloat(w[9])*woy + pfloat(w[10])*woz + pfloat(w[11]);
+				dx = pfloat(w[0])*wdx + pfloat(w[1])*wdy + pfloat(w[ 2])*wdz;
+				dy = pfloat(w[4])*wdx + pfloat(w[5])*wdy + pfloat(w[ 6])*wdz;
+				dz = pfloat(w[8])*wdx + pfloat(w[9])*wdy + pfloat(w[10])*wdz;
+			}
+			ox = ox - pfloat(s.x);
+			oy = oy - pfloat(s.y);
+			oz = oz - pfloat(s.z);
+
+			const pfloat a = dx*dx + dy*dy + dz*dz;
+			const pfloat pb = pfloat(2) * (ox*dx + oy*dy + oz*dz);
+			const pfloat pc = (ox*ox + oy*oy + oz*oz) - pfloat(s.radius*s.radius);
+			const pfloat disc = pb*pb - pfloat(4)*a*pc;
+			const pfloat root = pfloat::Sqrt(disc);
+			const pfloat t0 = (-pb - root) / pfloat(2) / a;
+			const pfloat t1 = (-pb + root) / pfloat(2) / a;
+
+			const pfloat hi = pfloat::Load(out.t_max);
+			const pmask in0 = (t0 > lo) & (t0 < hi);
+			const pmask in1 = (t1 > lo) & (t1 < hi);
+			int hits = ((disc >= pfloat(0)) & (in0 | in1)).Bits() & active;
+			if (hits == 0) continue;
+
+			alignas(32) float t[ray_packet::WIDTH];
+			pfloat::Select(in0, t0, t1).Store(t);
+			for (int l = 0; hits != 0; l++, hits >>= 1) {
+				if (!(hits & 1)) continue;
+				out.t_max[l] = t[l];
+				closestIndex[l] = i;
+			}
+		}
+	});
+
+	//Hit records only for the winners
+	for (int l = 0; l < ray_packet::WIDTH; l++) {
+		if (closestIndex[l] < 0) continue;
+		out.hits[l] = makeHit(closestIndex[l], rays.GetRay(l), out.t_max[l]);
+		out.mask |= 1 << l;
+	}
+}
+
+aabb Scene::bounds() const
+{
+	return tree.GetBounds();
+}
+
+Vector3 Scene::normal_at(const Vector3& /*pos*/)
+{
+	throw std::logic_error("Scene has no surface of its own; use trace_hit::normal instead");
+}
+
+#pragma endregion Tracing
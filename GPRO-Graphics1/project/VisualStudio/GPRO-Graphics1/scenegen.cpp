@@ -0,0 +1,182 @@
+#include "scenegen.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+SceneGenerator::SceneGenerator(const scene_distribution& distribution, const int& count, const uint32_t& seed) :
+	distribution{ distribution },
+	count{ count },
+	seed{ seed },
+	region{ Vector3(-20, -11, 30), Vector3(20, 11, 70) }, //Just inside the view at the near end
+	fill{ distribution == scene_distribution::GRID ? 0.45f : 0.25f },
+	clusters{ 0 },
+	clusterSpread{ 0.03f },
+	materials{ 8 }
+{
+	if (count <= 0 || count > MAX_COUNT) throw std::invalid_argument("Scenes are 1 to 10 million spheres!");
+}
+
+Color SceneGenerator::materialColor(const int& i) const
+{
+	return Color::FromHSV(i / (float)materials, 0.7f, 1.0f);
+}
+
+void SceneGenerator::validate() const
+{
+	const Vector3 size = region.GetSize();
+	if (count <= 0 || count > MAX_COUNT) throw std::invalid_argument("Scenes are 1 to 10 million spheres!");
+	if (!(size.x > 0 && size.y > 0 && size.z > 0)) throw std::invalid_argument("Region must have volume!");
+	if (!(fill > 0) || materials < 0) throw std::invalid_argument("Fill must be positive, and materials can't be negative!");
+}
+
+//cbrt isn't correctly rounded, so standard libraries can disagree on its last bit. This is
+//Newton's method from a power-of-two guess, a fixed number of steps, using nothing but IEEE
+//+, -, * and /, so it gives the same bits everywhere. Written so no step is a multiply-add
+//that a compiler could fuse. x must be positive and finite.
+static float cubeRoot(const double& x)
+{
+	int exponent;
+	frexp(x, &exponent); //Exact
+	double y = ldexp(1.0, exponent / 3);
+	for (int i = 0; i < 12; i++) y = (y + y + x / (y * y)) / 3;
+	return (float)y;
+}
+
+//Nearest whole number to n's cube root, in integers only. (k + 1/2)^3 is never whole, so there are no ties.
+static int nearestCubeRoot(const int& n)
+{
+	int k = 0;
+	while ((long long)(k + 1) * (k + 1) * (k + 1) <= n) k++;
+	const long long half = 2LL * k + 1;
+	return 8LL * n > half * half * half ? k + 1 : k;
+}
+
+template<typename F>
+void SceneGenerator::forEach(F&& emit) const
+{
+	const Vector3 size = region.GetSize();
+
+	//std's distributions differ between standard libraries, so every number comes straight from
+	//mt19937's bits, one draw per statement so evaluation order can't change them either
+	std::mt19937 rng(seed);
+	const auto unit = [&rng]() { return (float)(rng() >> 8) * (1.0f / 16777216.0f); }; //[0, 1)
+	const auto material = [&]() { return materials > 0 ? (int)(rng() % (uint32_t)materials) : Scene::NO_MATERIAL; };
+
+	//Average distance between centers if they were evenly spaced
+	const float spacing = cubeRoot((double)size.x * size.y * size.z / count);
+
+	switch (distribution) {
+	case scene_distribution::UNIFORM: {
+		const float radius = fill * spacing;
+		for (int i = 0; i < count; i++) {
+			const float x = region.min.x + unit() * size.x;
+			const float y = region.min.y + unit() * size.y;
+			const float z = region.min.z + unit() * size.z;
+			emit(Vector3(x, y, z), radius, material());
+		}
+		break;
+	}
+
+	case scene_distribution::CLUSTERED: {
+		const int clusterCount = clusters > 0 ? clusters : std::max(1, nearestCubeRoot(count));
+		std::vector<Vector3> centers;
+		centers.reserve(clusterCount);
+		for (int c = 0; c < clusterCount; c++) {
+			const float x = region.min.x + unit() * size.x;
+			const float y = region.min.y + unit() * size.y;
+			const float z = region.min.z + unit() * size.z;
+			centers.push_back(Vector3(x, y, z));
+		}
+
+		//Sum of four uniforms, rescaled to a standard deviation of 1. Close enough to normal, and
+		//unlike Box-Muller, needs no libm calls that could round differently elsewhere.
+		const auto normal = [&]() {
+			float sum = 0;
+			for (int k = 0; k < 4; k++) sum += unit();
+			return (sum - 2) * 1.7320508f;
+		};
+
+		const float radius = fill * spacing;
+		for (int i = 0; i < count; i++) {
+			const Vector3& c = centers[rng() % (uint32_t)clusterCount];
+			const float x = c.x + normal() * clusterSpread * size.x;
+			const float y = c.y + normal() * clusterSpread * size.y;
+			const float z = c.z + normal() * clusterSpread * size.z;
+			emit(Vector3(x, y, z), radius, material());
+		}
+		break;
+	}
+
+	case scene_distribution::GRID: {
+		//Near-cubic cells, enough of them for count. Filled x first, then y, so the front plane fills first.
+		const int nx = std::max(1, (int)ceilf(size.x / spacing));
+		const int ny = std::max(1, (int)ceilf(size.y / spacing));
+		int nz = std::max(1, (int)ceilf(size.z / spacing));
+		while ((long long)nx * ny * nz < count) nz++; //In case rounding came up short
+
+		const float cx = size.x / nx, cy = size.y / ny, cz = size.z / nz;
+		const float radius = fill * std::min(cx, std::min(cy, cz));
+		for (int i = 0; i < count; i++) {
+			const int ix = i % nx, iy = (i / nx) % ny, iz = i / (nx * ny);
+			emit(Vector3(region.min.x + (ix + 0.5f) * cx, region.min.y + (iy + 0.5f) * cy, region.min.z + (iz + 0.5f) * cz), radius, material());
+		}
+		break;
+	}
+
+	default:
+		throw std::invalid_argument("Unknown distribution!");
+	}
+}
+
+std::unique_ptr<Scene> SceneGenerator::generate(std::pmr::memory_resource* mem) const
+{
+	validate();
+	std::unique_ptr<Scene> scene(new Scene(bvh_tree::DEFAULT_LEAF_SIZE, mem));
+	for (int i = 0; i < materials; i++) scene->addMaterial(materialColor(i));
+	scene->reserve(count);
+	forEach([&](const Vector3& center, const float& radius, const int& material) { scene->add(center, radius, material); });
+	scene->rebuild();
+	return scene;
+}
+
+void SceneGenerator::write_to(std::ostream& out) const
+{
+	validate();
+	if (!out.good()) throw std::invalid_argument("File is not open!");
+
+	//Exactly what Scene::write_to(out, scene_format::PLAIN) would write for generate()'s scene before rebuilding
+	scene_file_header header;
+	header.magic = scene_file_header::MAGIC;
+	header.version = scene_file_header::VERSION;
+	header.flags = 0;
+	header.maxLeafSize = bvh_tree::DEFAULT_LEAF_SIZE;
+	header.materialCount = (uint32_t)materials;
+	header.transformCount = 0;
+	header.sphereCount = (uint32_t)count;
+	header.nodeCount = 0;
+	header.settings = Scene::DefaultSettings();
+	out.write((const char*)&header, sizeof(header));
+
+	for (int i = 0; i < materials; i++) {
+		const Color c = materialColor(i);
+		const float rgbs[4] = { c.r, c.g, c.b, c.GetScale() };
+		out.write((const char*)rgbs, sizeof(rgbs));
+	}
+
+	constexpr int BLOCK = 4096;
+	std::vector<scene_sphere> block;
+	block.reserve(BLOCK);
+	forEach([&](const Vector3& center, const float& radius, const int& material) {
+		block.push_back({ center.x, center.y, center.z, radius, material, Scene::NO_TRANSFORM });
+		if ((int)block.size() < BLOCK) return;
+		out.write((const char*)block.data(), sizeof(scene_sphere) * block.size());
+		block.clear();
+	});
+	out.write((const char*)block.data(), sizeof(scene_sphere) * block.size());
+
+	out.flush(); //So a full disk shows up here, not when out is closed
+	if (!out.good()) throw std::runtime_error("Couldn't write the whole scene!");
+}
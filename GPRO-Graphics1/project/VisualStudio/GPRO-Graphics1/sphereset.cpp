@@ -0,0 +1,212 @@
+#include "sphereset.hpp"
+
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <stdexcept>
+
+SphereSet::SphereSet() :
+	color{ Color::FromRGB(1, 0, 0) },
+	_count{ 0 }
+{ }
+
+void SphereSet::add(const Vector3& center, const float& radius)
+{
+	if (!(radius > 0)) throw std::invalid_argument("Sphere radius must be positive!");
+
+	if (_count % WIDTH == 0) {
+		block b;
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		for (int i = 0; i < WIDTH; i++) b.cx[i] = b.cy[i] = b.cz[i] = b.r[i] = nan;
+		_blocks.push_back(b);
+	}
+
+	block& b = _blocks.back();
+	const int lane = _count % WIDTH;
+	b.cx[lane] = center.x;
+	b.cy[lane] = center.y;
+	b.cz[lane] = center.z;
+	b.r [lane] = radius;
+	_count++;
+
+	_bounds.Expand(aabb(center - Vector3(radius, radius, radius), center + Vector3(radius, radius, radius)));
+}
+
+void SphereSet::reserve(const int& count)
+{
+	_blocks.reserve((count + WIDTH - 1) / WIDTH);
+}
+
+void SphereSet::clear()
+{
+	_blocks.clear();
+	_count = 0;
+	_bounds = aabb();
+}
+
+pmask SphereSet::solve(const block& b, const Ray& ray, const float& a, pfloat& t0, pfloat& t1)
+{
+	//Same quadratic as Sphere::intersect, with o relative to each center
+	const pfloat ox = pfloat(ray.origin.x) - pfloat::Load(b.cx);
+	const pfloat oy = pfloat(ray.origin.y) - pfloat::Load(b.cy);
+	const pfloat oz = pfloat(ray.origin.z) - pfloat::Load(b.cz);
+	const pfloat dx = pfloat(ray.direction.x), dy = pfloat(ray.direction.y), dz = pfloat(ray.direction.z);
+	const pfloat r = pfloat::Load(b.r);
+
+	const pfloat pa = pfloat(a);
+	const pfloat pb = pfloat(2) * (ox*dx + oy*dy + oz*dz);
+	const pfloat pc = (ox*ox + oy*oy + oz*oz) - r*r;
+
+	const pfloat disc = pb*pb - pfloat(4)*pa*pc;
+	const pfloat root = pfloat::Sqrt(disc);
+	t0 = (-pb - root) / pfloat(2) / pa;
+	t1 = (-pb + root) / pfloat(2) / pa;
+	return disc >= pfloat(0);
+}
+
+trace_hit SphereSet::makeHit(const Ray& ray, const int& index, const float& t) const
+{
+	Vector3 pos = ray.GetByT(t);
+	return trace_hit(pos, Vector3(pos - GetCenter(index)).Normalize(), color, t);
+}
+
+void SphereSet::trace(const Ray& ray, hit_buffer& out)
+{
+	const float a = ray.direction.Dot(ray.direction);
+
+	for (int bi = 0; bi < (int)_blocks.size(); bi++) {
+		pfloat t0, t1;
+		const int real = solve(_blocks[bi], ray, a, t0, t1).Bits();
+		if (real == 0) continue;
+
+		alignas(32) float tNear[WIDTH], tFar[WIDTH];
+		t0.Store(tNear);
+		t1.Store(tFar);
+		for (int i = 0; i < WIDTH; i++) {
+			if (!((real >> i) & 1)) continue;
+			//Prevent rendering stuff behind the camera, same as Sphere::trace
+			if (tNear[i] > 0) out.push_back(makeHit(ray, bi*WIDTH + i, tNear[i]));
+			if (tFar[i] > 0 && tFar[i] != tNear[i]) out.push_back(makeHit(ray, bi*WIDTH + i, tFar[i]));
+		}
+	}
+}
+
+bool SphereSet::trace_closest(const Ray& ray, const float& t_min, const float& t_max, trace_hit& out)
+{
+	const float a = ray.direction.Dot(ray.direction);
+	const pfloat lo = pfloat(t_min);
+
+	float closest = t_max;
+	int closestIndex = -1;
+	for (int bi = 0; bi < (int)_blocks.size(); bi++) {
+		pfloat t0, t1;
+		const pmask real = solve(_blocks[bi], ray, a, t0, t1);
+
+		//Near root if it's in range, otherwise far root
+		const pfloat hi = pfloat(closest);
+		const pmask in0 = (t0 > lo) & (t0 < hi);
+		const pmask in1 = (t1 > lo) & (t1 < hi);
+		int hits = (real & (in0 | in1)).Bits();
+		if (hits == 0) continue;
+
+		alignas(32) float t[WIDTH];
+		pfloat::Select(in0, t0, t1).Store(t);
+		for (int i = 0; hits != 0; i++, hits >>= 1) {
+			if ((hits & 1) && t[i] < closest) {
+				closest = t[i];
+				closestIndex = bi*WIDTH + i;
+			}
+		}
+	}
+
+	if (closestIndex < 0) return false;
+	out = makeHit(ray, closestIndex, closest);
+	return true;
+}
+
+bool SphereSet::trace_any(const Ray& ray, const float& t_min, const float& t_max)
+{
+	const float a = ray.direction.Dot(ray.direction);
+	const pfloat lo = pfloat(t_min), hi = pfloat(t_max);
+
+	for (const block& b : _blocks) {
+		pfloat t0, t1;
+		const pmask real = solve(b, ray, a, t0, t1);
+		const pmask in0 = (t0 > lo) & (t0 < hi);
+		const pmask in1 = (t1 > lo) & (t1 < hi);
+		if ((real & (in0 | in1)).Bits() != 0) return true;
+	}
+	return false;
+}
+
+void SphereSet::trace_packet(const ray_packet& rays, const float& t_min, packet_hit& out, const int& lanes)
+{
+	//Here the packet is the vector and spheres are the loop, one at a time. Per lane,
+	//every op matches solve(), so results agree with trace_closest.
+	const pfloat wox = pfloat::Load(rays.ox), woy = pfloat::Load(rays.oy), woz = pfloat::Load(rays.oz);
+	const pfloat dx = pfloat::Load(rays.dx), dy = pfloat::Load(rays.dy), dz = pfloat::Load(rays.dz);
+	const pfloat a = dx*dx + dy*dy + dz*dz;
+	const pfloat lo = pfloat(t_min);
+
+	int closestIndex[ray_packet::WIDTH];
+	for (int i = 0; i < ray_packet::WIDTH; i++) closestIndex[i] = -1;
+
+	for (int s = 0; s < _count; s++) {
+		const block& b = _blocks[s / WIDTH];
+		const int lane = s % WIDTH;
+
+		const pfloat ox = wox - pfloat(b.cx[lane]);
+		const pfloat oy = woy - pfloat(b.cy[lane]);
+		const pfloat oz = woz - pfloat(b.cz[lane]);
+		const pfloat r = pfloat(b.r[lane]);
+
+		const pfloat pb = pfloat(2) * (ox*dx + oy*dy + oz*dz);
+		const pfloat pc = (ox*ox + oy*oy + oz*oz) - r*r;
+		const pfloat disc = pb*pb - pfloat(4)*a*pc;
+		const pfloat root = pfloat::Sqrt(disc);
+		const pfloat t0 = (-pb - root) / pfloat(2) / a;
+		const pfloat t1 = (-pb + root) / pfloat(2) / a;
+
+		const pfloat hi = pfloat::Load(out.t_max);
+		const pmask in0 = (t0 > lo) & (t0 < hi);
+		const pmask in1 = (t1 > lo) & (t1 < hi);
+		int hits = ((disc >= pfloat(0)) & (in0 | in1)).Bits() & lanes;
+		if (hits == 0) continue;
+
+		alignas(32) float t[ray_packet::WIDTH];
+		pfloat::Select(in0, t0, t1).Store(t);
+		for (int i = 0; hits != 0; i++, hits >>= 1) {
+			if (!(hits & 1)) continue;
+			out.t_max[i] = t[i];
+			closestIndex[i] = s;
+		}
+	}
+
+	//Hit records only for the winners
+	for (int i = 0; i < ray_packet::WIDTH; i++) {
+		if (closestIndex[i] < 0) continue;
+		out.hits[i] = makeHit(rays.GetRay(i), closestIndex[i], out.t_max[i]);
+		out.mask |= 1 << i;
+	}
+}
+
+aabb SphereSet::bounds() const
+{
+	return _bounds;
+}
+
+Vector3 SphereSet::normal_at(const Vector3& pos)
+{
+	if (_count == 0) throw std::logic_error("Empty SphereSet has no surface");
+
+	int nearest = 0;
+	float nearestDist = FLT_MAX;
+	for (int i = 0; i < _count; i++) {
+		const float dist = fabsf(Vector3(pos - GetCenter(i)).GetMagnitude() - GetRadius(i));
+		if (dist < nearestDist) {
+			nearestDist = dist;
+			nearest = i;
+		}
+	}
+	return Vector3(pos - GetCenter(nearest)).Normalize();
+}
@@ -0,0 +1,129 @@
+#include "threadpool.hpp"
+
+#include <algorithm> /* max */
+
+unsigned int ThreadPool::resolveThreadCount(unsigned int threadCount)
+{
+	if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	return threadCount > 0 ? threadCount : 1; //hardware_concurrency is allowed to return 0
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount) :
+	nextQueue{ 0 },
+	queued{ 0 },
+	pending{ 0 },
+	stopping{ false }
+{
+	threadCount = resolveThreadCount(threadCount);
+
+	//Queues must all exist before any worker tries to steal from them
+	for (unsigned int i = 0; i < threadCount; i++) queues.push_back(std::make_unique<worker_queue>());
+	for (unsigned int i = 0; i < threadCount; i++) workers.emplace_back(&ThreadPool::workerMain, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wakeWorkers.notify_all();
+	for (std::thread& t : workers) t.join();
+}
+
+void ThreadPool::worker_queue::grow(size_t capacity)
+{
+	if (capacity <= tasks.size()) return;
+
+	//Unwrap into the new ring, oldest first
+	std::vector<task_t> larger(capacity);
+	for (size_t i = 0; i < count; i++) larger[i] = at(i);
+	tasks.swap(larger);
+	first = 0;
+}
+
+void ThreadPool::reserve(int tasks)
+{
+	//Round-robin never deals one queue more than its share, rounded up
+	const size_t perQueue = (size_t)(tasks + size() - 1) / size();
+	for (std::unique_ptr<worker_queue>& queue : queues) {
+		std::lock_guard<std::mutex> guard(queue->lock);
+		queue->grow(perQueue);
+	}
+}
+
+void ThreadPool::submit(const task_t& task)
+{
+	unsigned int target = nextQueue++ % size();
+
+	pending++;
+	{
+		worker_queue& queue = *queues[target];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.count == queue.tasks.size()) queue.grow(std::max<size_t>(16, queue.tasks.size() * 2));
+		queue.count++;
+		queue.at(queue.count - 1) = task;
+	}
+
+	//Bump queued under the sleep lock, so a worker can't check it and go to sleep in between
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		queued++;
+	}
+	wakeWorkers.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> guard(sleepLock);
+	tasksDone.wait(guard, [this]() { return pending == 0; });
+}
+
+bool ThreadPool::tryPop(unsigned int self, task_t& out)
+{
+	//Own queue first, newest task (LIFO keeps the cache warm)
+	{
+		worker_queue& own = *queues[self];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (own.count > 0) {
+			out = own.at(own.count - 1);
+			own.count--;
+			return true;
+		}
+	}
+
+	//Then steal someone else's oldest task
+	for (unsigned int i = 1; i < size(); i++) {
+		worker_queue& victim = *queues[(self + i) % size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (victim.count > 0) {
+			out = victim.at(0);
+			victim.first = (victim.first + 1) % victim.tasks.size();
+			victim.count--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::workerMain(unsigned int self)
+{
+	task_t task{};
+	while (true) {
+		if (tryPop(self, task)) {
+			queued--;
+			task.run(task.context, task.index);
+
+			if (--pending == 0) {
+				std::lock_guard<std::mutex> guard(sleepLock);
+				tasksDone.notify_all();
+			}
+		}
+		else {
+			std::unique_lock<std::mutex> guard(sleepLock);
+			wakeWorkers.wait(guard, [this]() { return stopping || queued > 0; });
+			if (stopping && queued == 0) return;
+		}
+	}
+}
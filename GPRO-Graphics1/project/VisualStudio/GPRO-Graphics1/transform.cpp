@@ -0,0 +1,26 @@
+#include "transform.hpp"
+
+Transform::Transform() : Transform(mat4::Identity())
+{ }
+
+Transform::Transform(const mat4& localToWorld) :
+	_version{ 0 }
+{
+	SetLocalToWorld(localToWorld);
+}
+
+void Transform::SetLocalToWorld(const mat4& value)
+{
+	_ltw = value;
+	_wtl = value.Inverse();
+	_normal = _wtl.Transpose();
+	_version++;
+}
+
+void Transform::SetWorldToLocal(const mat4& value)
+{
+	_wtl = value;
+	_ltw = value.Inverse();
+	_normal = _wtl.Transpose();
+	_version++;
+}
@@ -30,37 +30,6 @@
 
 #include <cmath>
 
-Vector3::Vector3(const float& _x, const float& _y, const float& _z) : float3(_x, _y, _z), x{ val0 }, y{ val1 }, z{ val2 }
-{ }
-
-Vector3::Vector3(const float3& base) : float3(base), x{ val0 }, y{ val1 }, z{ val2 }
-{ }
-
-Vector3 Vector3::operator=(const float3& _rhs)
-{
-	//UNSAFE! But gives us access to internal values. Just don't try any
-	//function calls, there's no telling what will happen.
-	const Vector3* const rhs = reinterpret_cast<const Vector3* const>(&_rhs);
-
-	this->val0 = rhs->val0;
-	this->val1 = rhs->val1;
-	this->val2 = rhs->val2;
-	return *this;
-}
-
-Vector3 Vector3::operator=(const Vector3& rhs)
-{
-	this->val0 = rhs.val0;
-	this->val1 = rhs.val1;
-	this->val2 = rhs.val2;
-	return *this;
-}
-
-float Vector3::GetMagnitude() const
-{
-	return sqrtf(x*x+y*y+z*z);
-}
-
 Vector3 Vector3::WithMagnitude(const float& m) const
 {
 	return (*this) * (m / GetMagnitude());
@@ -71,25 +40,6 @@ Vector3 Vector3::WithBoundedMagnitude(const float& min, const float& max) const
 	return GetMagnitude() < min ? WithMagnitude(min) : (GetMagnitude() > max ? WithMagnitude(max) : Vector3(*this));
 }
 
-Vector3 Vector3::Normalize() const
-{
-	return (*this) / GetMagnitude();
-}
-
-float Vector3::Dot(const Vector3& other) const
-{
-	return x*other.x + y*other.y + z*other.z;
-}
-
-Vector3 Vector3::Cross(const Vector3& other) const
-{
-	return Vector3(
-		this->y*other.z - this->z*other.y,
-		this->z*other.x - this->x*other.z,
-		this->x*other.y - this->y*other.x
-	);
-}
-
 float Vector3::Angle(const Vector3& other) const
 {
 	//a dot b = |a|*|b| * cos(ang)
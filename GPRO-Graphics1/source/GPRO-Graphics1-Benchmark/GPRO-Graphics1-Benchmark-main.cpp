@@ -0,0 +1,587 @@
+/*
+	Copyright 2020 Robert S. Christensen
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+
+/*
+	GPRO-Graphics1-Benchmark-main.cpp
+
+	Microbenchmarks for the math and trace kernels, plus full renders of
+	a few fixed scenes. Everything is seeded and single-threaded unless
+	the name says otherwise, and each timing is the best of several
+	repeats, so numbers are comparable run to run.
+
+	Reports ns/op, allocations/op (every global operator new in the
+	process is counted), and rays/second for anything that traces.
+
+	Usage: GPRO-Graphics1-Benchmark [filter]
+	Only benchmarks whose name contains filter are run. The 10^7 sphere
+	scaling renders only run when filter includes "10^7".
+
+	Usage: GPRO-Graphics1-Benchmark --check-simd
+	Checks float3 and Vector3 math against the scalar path over a million
+	random inputs, bit for bit, and prints a hash of every result. Run it
+	in a build with GPRO_NO_SIMD defined too: both must print the same hash.
+*/
+
+#ifndef __cplusplus
+#error "Project is C++ only. Does NOT support C."
+#endif
+
+#include "camera.hpp"
+#include "image.hpp"
+#include "raytrace.hpp"
+#include "sphereset.hpp"
+#include "staticscene.hpp"
+#include "bvh.hpp"
+#include "grid.hpp"
+#include "instance.hpp"
+#include "mesh.hpp"
+#include "scene.hpp"
+#include "scenegen.hpp"
+#include "scanlinewriter.hpp"
+#include "matrix.hpp"
+#include "arena.hpp"
+
+#include "moremath.inl"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio> /* remove */
+#include <cstdlib>
+#include <cstring> /* memcpy */
+#ifdef _WIN32
+#include <malloc.h> /* _aligned_malloc */
+#endif
+#include <new>
+#include <vector>
+#include <random>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#pragma region Allocation counting
+
+static std::atomic<long long> allocationCount{ 0 };
+
+void* operator new(std::size_t size)
+{
+	allocationCount++;
+	if (void* p = std::malloc(size > 0 ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+//Over-aligned types, and std::pmr::new_delete_resource, come through these
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	allocationCount++;
+	const std::size_t align = (std::size_t)alignment;
+#ifdef _WIN32
+	if (void* p = _aligned_malloc(size > 0 ? size : 1, align)) return p;
+#else
+	if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) return p;
+#endif
+	throw std::bad_alloc();
+}
+
+#ifdef _WIN32
+void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { _aligned_free(p); }
+#else
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
+
+#pragma endregion Allocation counting
+
+#pragma region Harness
+
+//Repeats per benchmark. The fastest one is reported, since anything slower is noise from elsewhere.
+static constexpr int REPEATS = 5;
+
+//Results are summed into here so the optimizer can't drop the work
+static volatile float sink;
+
+//Swallows whatever is written to it, so Image::write_to is timed without any disk I/O
+class null_buffer final : public std::streambuf {
+protected:
+	virtual int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+	virtual std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+//op is called opsPerRepeat times per repeat and returns any float derived from its work
+template<typename F>
+static void bench(const std::string& filter, const std::string& name, const long long& opsPerRepeat, const long long& raysPerOp, F&& op)
+{
+	if (name.find(filter) == std::string::npos) return;
+
+	sink = sink + op(); //Warm caches and any lazy state
+
+	double bestNs = 1e300;
+	long long allocs = 0;
+	for (int rep = 0; rep < REPEATS; rep++) {
+		const long long allocsBefore = allocationCount;
+		const auto start = std::chrono::steady_clock::now();
+
+		float sum = 0;
+		for (long long i = 0; i < opsPerRepeat; i++) sum += op();
+
+		const auto end = std::chrono::steady_clock::now();
+		allocs += allocationCount - allocsBefore;
+		sink = sink + sum;
+
+		bestNs = std::min(bestNs, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+
+	const double nsPerOp = bestNs / opsPerRepeat;
+	std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+		<< std::setw(16) << std::setprecision(1) << nsPerOp
+		<< std::setw(14) << std::setprecision(2) << allocs / double(REPEATS * opsPerRepeat);
+	if (raysPerOp > 0) std::cout << std::setw(14) << std::setprecision(3) << raysPerOp / nsPerOp * 1e3; //Rays per ns, in millions per second
+	std::cout << std::endl;
+}
+
+//Render without the progress bar
+static float renderQuiet(Camera& cam, const std::vector<Traceable*>& objects)
+{
+	std::streambuf* old = std::cout.rdbuf(nullptr);
+	cam.render(objects);
+	std::cout.rdbuf(old);
+	return cam.viewport->get_pixel(0, 0).g;
+}
+
+static float renderQuiet(Camera& cam, Traceable& scene)
+{
+	std::streambuf* old = std::cout.rdbuf(nullptr);
+	cam.render(scene);
+	std::cout.rdbuf(old);
+	return cam.viewport->get_pixel(0, 0).g;
+}
+
+#pragma endregion Harness
+
+#pragma region SIMD check
+
+//Same math as rawdata.hpp and vector.hpp's GPRO_NO_SIMD paths, written out here so every
+//build has them to compare against, whichever path float3 itself uses.
+static float3 scalarNegate(const Vector3& a) { return Vector3(-a.x, -a.y, -a.z); }
+static float3 scalarAdd(const Vector3& a, const Vector3& b) { return Vector3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static float3 scalarSub(const Vector3& a, const Vector3& b) { return Vector3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static float3 scalarMul(const Vector3& a, const float& s) { return Vector3(a.x * s, a.y * s, a.z * s); }
+static float3 scalarDiv(const Vector3& a, const float& s) { return Vector3(a.x / s, a.y / s, a.z / s); }
+static float scalarDot(const Vector3& a, const Vector3& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+static Vector3 scalarCross(const Vector3& a, const Vector3& b) { return Vector3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x); }
+
+//Runs every float3 and Vector3 operation over SAMPLES seeded inputs. Returns how many
+//results differ from the scalar path in any bit, and prints a hash of all of them.
+static int checkVectorMath()
+{
+	constexpr int SAMPLES = 1000000;
+
+	//Straight from mt19937's bits, so every standard library draws the same inputs
+	std::mt19937 rng(7);
+	const auto unit = [&rng]() { return (float)(rng() >> 8) * (1.0f / 16777216.0f); }; //[0, 1)
+	const auto component = [&]() {
+		const float v = unit() * 200 - 100;
+		//One in 16 is scaled from denormal to near overflow, to catch any difference in edge cases
+		if ((rng() & 15) != 0) return v;
+		const int exponent = (int)(rng() % 260) - 140;
+		return ldexpf(v, exponent);
+	};
+
+	uint64_t hash = 14695981039346656037ull; //FNV-1a
+	int mismatches = 0;
+	const auto record = [&](const float& actual, const float& expected) {
+		uint32_t a, e;
+		memcpy(&a, &actual, sizeof(a));
+		memcpy(&e, &expected, sizeof(e));
+		if (a != e) mismatches++;
+		hash = (hash ^ a) * 1099511628211ull;
+	};
+	const auto record3 = [&](const Vector3& actual, const Vector3& expected) {
+		record(actual.x, expected.x);
+		record(actual.y, expected.y);
+		record(actual.z, expected.z);
+	};
+
+	for (int i = 0; i < SAMPLES; i++) {
+		const float ax = component(), ay = component(), az = component();
+		const float bx = component(), by = component(), bz = component();
+		const float s = component();
+		const Vector3 a(ax, ay, az), b(bx, by, bz);
+
+		record3(-a   , scalarNegate(a));
+		record3(a + b, scalarAdd(a, b));
+		record3(a - b, scalarSub(a, b));
+		record3(a * s, scalarMul(a, s));
+		record3(s * a, scalarMul(a, s));
+		record3(a / s, scalarDiv(a, s));
+
+		Vector3 c = a;
+		c += b; c -= a; c *= s; c /= s;
+		record3(c, scalarDiv(scalarMul(scalarSub(scalarAdd(a, b), a), s), s));
+
+		record(a.Dot(b), scalarDot(a, b));
+		record3(a.Cross(b), scalarCross(a, b));
+		record(a.GetMagnitude(), sqrtf(scalarDot(a, a)));
+		record3(a.Normalize(), scalarDiv(a, sqrtf(scalarDot(a, a))));
+	}
+
+#ifdef GPRO_SIMD_SSE
+	const char* const path = "SSE";
+#else
+	const char* const path = "scalar";
+#endif
+	std::cout << "float3/Vector3 math, " << SAMPLES << " samples, " << path << " path: hash "
+		<< std::hex << std::setw(16) << std::setfill('0') << hash << std::dec << std::setfill(' ')
+		<< ", " << mismatches << " results differ from scalar" << std::endl;
+	return mismatches;
+}
+
+#pragma endregion SIMD check
+
+int main(int const argc, char const* const argv[])
+{
+	const std::string filter = argc > 1 ? argv[1] : "";
+	if (filter == "--check-simd") return checkVectorMath() == 0 ? 0 : 1;
+
+	std::cout << std::left << std::setw(40) << "benchmark" << std::right
+		<< std::setw(16) << "ns/op"
+		<< std::setw(14) << "allocs/op"
+		<< std::setw(14) << "Mrays/s" << std::endl;
+
+	#pragma region Math
+
+	{
+		matrix m = matrix::Translate(Vector3(1, 2, 3));
+		m(0, 1) = 0.5f;
+		m(2, 0) = 0.25f;
+		bench(filter, "matrix::Inverse 4x4"    , 1000, 0, [&]() { return m.Inverse().at_c(3, 0); });
+		bench(filter, "matrix::Determinant 4x4", 1000, 0, [&]() { return m.Determinant(); });
+		bench(filter, "matrix::Adjugate 4x4"   , 1000, 0, [&]() { return m.Adjugate().at_c(3, 0); });
+
+		//Same, with every temporary coming from an Arena that's freed all at once
+		Arena arena;
+		bench(filter, "matrix::Inverse 4x4, arena", 1000, 0, [&]() { arena.reset(); return matrix(m, &arena).Inverse().at_c(3, 0); });
+	}
+
+	{
+		//Something closer to what scene preprocessing solves
+		std::mt19937 rng(3);
+		std::uniform_real_distribution<float> u(-1, 1);
+		matrix m = matrix::Zero(32);
+		for (int x = 0; x < m.size; x++) for (int y = 0; y < m.size; y++) m(x, y) = u(rng);
+		std::vector<float> b(m.size);
+		for (float& v : b) v = u(rng);
+
+		bench(filter, "matrix::Determinant 32x32", 1000, 0, [&]() { return m.Determinant(); });
+		bench(filter, "matrix::Solve 32x32"      , 1000, 0, [&]() { return m.Solve(b)[0]; });
+		bench(filter, "matrix::Inverse 32x32"    ,  100, 0, [&]() { return m.Inverse().at_c(0, 0); });
+
+		//Evaluated in one loop into the result, so one allocation
+		matrix n = m.Transpose();
+		bench(filter, "matrix (A^T * B) / 2 32x32", 1000, 0, [&]() { matrix r = (m.Transpose() * n).CheckerboardSign() / 2; return r.at_c(0, 0); });
+	}
+
+	{
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> u(-10, 10);
+		std::vector<Vector3> vecs;
+		for (int i = 0; i < 1024; i++) vecs.push_back(Vector3(u(rng), u(rng), u(rng)));
+
+		int i = 0;
+		bench(filter, "Vector3::Normalize", 1000000, 0, [&]() { return vecs[(i++) & 1023].Normalize().x; });
+	}
+
+	#pragma endregion Math
+
+	#pragma region Trace
+
+	{
+		Sphere sphere(Vector3::forward() * 3, 0.5f);
+		const Ray ray(Vector3::zero(), Vector3(0.05f, 0.05f, 1));
+
+		bench(filter, "Sphere::trace"        ,  100000, 1, [&]() { return (float)sphere.trace(ray).size(); });
+
+		Arena arena;
+		hit_buffer hits(&arena);
+		bench(filter, "Sphere::trace, hit_buffer", 100000, 1, [&]() { hits.clear(); sphere.trace(ray, hits); return (float)hits.size(); });
+		bench(filter, "Sphere::trace_closest", 1000000, 1, [&]() { trace_hit hit; sphere.trace_closest(ray, 0, FLT_MAX, hit); return hit.t; });
+		bench(filter, "Sphere::localToWorld read", 1000000, 0, [&]() { return ((mat4)sphere.localToWorld).TransformPoint(Vector3::zero()).z; });
+	}
+
+	{
+		Image viewport(16*20, 9*20, 255);
+		Camera cam(viewport, 75.0f*DEG2RAD);
+		const int w = viewport.width, h = viewport.height;
+
+		int i = 0;
+		bench(filter, "Camera::prepareTracer", w*h, 1, [&]() { Ray r = cam.prepareTracer(i % w, (i / w) % h); i++; return r.direction.x; });
+
+		//Per row, so ns/op divided by w is the cost of one ray
+		std::vector<float> dx(w), dy(w), dz(w);
+		int y = 0;
+		bench(filter, "ray_table::GetRow"  , h, w, [&]() { cam.getRayTable(w, h)->GetRow((y++) % h, 0, w, dx.data(), dy.data(), dz.data()); return dx[0] + dy[0]; });
+		bench(filter, "Camera::getRayTable", 100, 0, [&]() { cam.fov += 1e-6f; return cam.getRayTable(w, h)->tanX[0]; });
+	}
+
+	{
+		Image viewport(16*20, 9*20, 255);
+		null_buffer buf;
+		std::ostream out(&buf);
+
+		bench(filter, "Image::write_to 320x180 P3", 10, 0, [&]() { viewport.write_to(out, image_format::P3); return 0.0f; });
+		bench(filter, "Image::write_to 320x180 P6", 10, 0, [&]() { viewport.write_to(out, image_format::P6); return 0.0f; });
+	}
+
+	{
+		//Walks a big float image in 8x8 blocks, a column of blocks at a time, like a vertical filter pass would
+		const struct { const char* name; pixel_layout layout; } layouts[] = {
+			{ "Image 8x8 block walk, ROW_MAJOR", pixel_layout::ROW_MAJOR },
+			{ "Image 8x8 block walk, TILED"    , pixel_layout::TILED     },
+			{ "Image 8x8 block walk, MORTON"   , pixel_layout::MORTON    }
+		};
+		for (const auto& l : layouts) {
+			Image image(2048, 2048, 1, pixel_format::RGB32F, l.layout);
+			bench(filter, l.name, 2, 0, [&]() {
+				float sum = 0;
+				for (int bx = 0; bx < image.width; bx += 8) for (int by = 0; by < image.height; by += 8)
+					for (int y = by; y < by + 8; y++) for (int x = bx; x < bx + 8; x++) sum += image.get_pixel(x, y).r;
+				return sum;
+			});
+		}
+	}
+
+	#pragma endregion Trace
+
+	#pragma region Render
+
+	{
+		//Fixed scenes. Same seed every run, so every run traces the same rays.
+		std::vector<Traceable*> oneSphere;
+		oneSphere.push_back(new Sphere(Vector3::forward(), 0.5f));
+
+		std::mt19937 rng(2);
+		std::uniform_real_distribution<float> ux(-10, 10), uz(5, 40);
+		std::vector<Traceable*> manySpheres;
+		StaticScene<Sphere> staticSpheres; //Same spheres, stored by value
+		InstanceSet instancedSpheres;      //Same spheres again, as instances of one
+		Sphere unitSphere(Vector3::zero(), 0.5f);
+		const int ball = instancedSpheres.addGeometry(&unitSphere);
+		for (int i = 0; i < 300; i++) {
+			const Vector3 center(ux(rng), ux(rng), uz(rng));
+			manySpheres.push_back(new Sphere(center, 0.5f));
+			staticSpheres.add<Sphere>(center, 0.5f);
+			instancedSpheres.add(ball, mat4::Translate(center));
+		}
+		staticSpheres.rebuild();
+		instancedSpheres.rebuild();
+
+		SphereSet* set = new SphereSet();
+		for (int i = 0; i < 1024; i++) set->add(Vector3(ux(rng), ux(rng), uz(rng)), 0.25f);
+		std::vector<Traceable*> sphereSet{ set };
+
+		Image viewport(16*20, 9*20, 255);
+		Camera cam(viewport, 75.0f*DEG2RAD);
+		const int rays = viewport.width * viewport.height;
+
+		null_buffer discardBuf;
+		std::ostream discard(&discardBuf);
+
+		cam.threadCount = 1;
+		bench(filter, "render 1 sphere"                , 10, rays, [&]() { return renderQuiet(cam, oneSphere  ); });
+		bench(filter, "render 300 spheres"             ,  5, rays, [&]() { return renderQuiet(cam, manySpheres); });
+		bench(filter, "render SphereSet 1024"          ,  2, rays, [&]() { return renderQuiet(cam, sphereSet  ); });
+		cam.usePackets = false;
+		bench(filter, "render 300 spheres, no packets" ,  5, rays, [&]() { return renderQuiet(cam, manySpheres); });
+		bench(filter, "render 300 spheres, no packets, static",  5, rays, [&]() { return renderQuiet(cam, staticSpheres); });
+		cam.usePackets = true;
+		bench(filter, "render 300 spheres, StaticScene",  5, rays, [&]() { return renderQuiet(cam, staticSpheres); });
+		bench(filter, "render 300 spheres, instanced"  ,  5, rays, [&]() { return renderQuiet(cam, instancedSpheres); });
+		bench(filter, "render 300 spheres + P6"        ,  5, rays, [&]() { renderQuiet(cam, manySpheres); cam.viewport->write_to(discard, image_format::P6); return 0.0f; });
+		bench(filter, "render 300 spheres, streamed P6",  5, rays, [&]() {
+			ScanlineWriter out(discard, viewport.width, viewport.height);
+			std::streambuf* old = std::cout.rdbuf(nullptr);
+			cam.render(manySpheres, out);
+			std::cout.rdbuf(old);
+			return 0.0f;
+		});
+		Arena frame;
+		cam.arena = &frame;
+		bench(filter, "render 300 spheres, reused arena", 5, rays, [&]() { return renderQuiet(cam, manySpheres); });
+		//4 rather than all, so even a machine with one core goes through the thread pool
+		cam.threadCount = 4;
+		bench(filter, "render 300 spheres, arena, 4 threads", 5, rays, [&]() { return renderQuiet(cam, manySpheres); });
+		cam.arena = nullptr;
+		cam.threadCount = 0;
+		bench(filter, "render 300 spheres, all threads", 5, rays, [&]() { return renderQuiet(cam, manySpheres); });
+
+		cam.threadCount = 1;
+		cam.accelerator = scene_accelerator::BVH;
+		bench(filter, "render 300 spheres, BVH"        ,  5, rays, [&]() { return renderQuiet(cam, manySpheres); });
+		cam.accelerator = scene_accelerator::GRID;
+		bench(filter, "render 300 spheres, grid"       ,  5, rays, [&]() { return renderQuiet(cam, manySpheres); });
+		cam.accelerator = scene_accelerator::AUTO;
+
+		for (Traceable* obj : oneSphere  ) delete obj;
+		for (Traceable* obj : manySpheres) delete obj;
+		for (Traceable* obj : sphereSet  ) delete obj;
+	}
+
+	{
+		//Animated scene: everything moves, so the acceleration structure is rebuilt every frame
+		std::mt19937 rng(4);
+		std::uniform_real_distribution<float> u(-50, 50);
+		std::vector<Traceable*> swarm;
+		for (int i = 0; i < 50000; i++) swarm.push_back(new Sphere(Vector3(u(rng), u(rng), u(rng) + 100), 0.3f));
+
+		BVH bvh(swarm);
+		UniformGrid grid(swarm, uniform_grid::DEFAULT_DENSITY, 1);
+		UniformGrid gridAllThreads(swarm);
+		bench(filter, "BVH::rebuild 50k spheres"                  , 5, 0, [&]() { bvh.rebuild(); return (float)bvh.GetTree().nodes.size(); });
+		bench(filter, "UniformGrid::rebuild 50k spheres"          , 5, 0, [&]() { grid.rebuild(); return (float)grid.GetGrid().indices.size(); });
+		bench(filter, "UniformGrid::rebuild 50k spheres, threaded", 5, 0, [&]() { gridAllThreads.rebuild(); return (float)gridAllThreads.GetGrid().indices.size(); });
+
+		Image viewport(16*20, 9*20, 255);
+		Camera cam(viewport, 75.0f*DEG2RAD);
+		const int rays = viewport.width * viewport.height;
+		Arena frame;
+		cam.arena = &frame;
+		cam.accelerator = scene_accelerator::BVH;
+		bench(filter, "animated frame 50k spheres, BVH" , 2, rays, [&]() { return renderQuiet(cam, swarm); });
+		cam.accelerator = scene_accelerator::GRID;
+		bench(filter, "animated frame 50k spheres, grid", 2, rays, [&]() { return renderQuiet(cam, swarm); });
+
+		for (Traceable* obj : swarm) delete obj;
+	}
+
+	{
+		//A million copies of one sphere. As separate Spheres this would be a quarter of a gigabyte of objects.
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> u(-200, 200);
+		Sphere unitSphere(Vector3::zero(), 0.3f);
+		InstanceSet crowd;
+		const int ball = crowd.addGeometry(&unitSphere);
+		for (int i = 0; i < 1000000; i++) crowd.add(ball, mat4::Translate(Vector3(u(rng), u(rng), u(rng) + 400)));
+		bench(filter, "InstanceSet::rebuild 1M instances", 1, 0, [&]() { crowd.rebuild(); return (float)crowd.GetTree().nodes.size(); });
+
+		Image viewport(16*20, 9*20, 255);
+		Camera cam(viewport, 75.0f*DEG2RAD);
+		bench(filter, "render 1M instanced spheres", 2, viewport.width * viewport.height, [&]() { return renderQuiet(cam, crowd); });
+	}
+
+	{
+		//A tessellated sphere, 256x512 quads, round-tripped through a .gpm file
+		const int rings = 256, segments = 512;
+		std::vector<Vector3> vertices;
+		std::vector<uint32_t> indices;
+		for (int i = 0; i <= rings; i++) {
+			for (int j = 0; j < segments; j++) {
+				const float theta = PI * i / rings, phi = 2 * PI * j / segments;
+				vertices.push_back(Vector3(2 * sinf(theta) * cosf(phi), 2 * cosf(theta), 6 + 2 * sinf(theta) * sinf(phi)));
+			}
+		}
+		for (uint32_t i = 0; i < rings; i++) {
+			for (uint32_t j = 0; j < segments; j++) {
+				const uint32_t a = i * segments + j, b = i * segments + (j + 1) % segments;
+				indices.insert(indices.end(), { a, a + segments, b, b, a + segments, b + segments });
+			}
+		}
+
+		const std::string path = "benchmark-sphere.gpm";
+		{
+			std::ofstream file(path, std::ios::binary);
+			mesh_buffers::FromArrays(vertices, indices)->write_to(file);
+		}
+
+		std::shared_ptr<const mesh_buffers> buffers;
+		bench(filter, "mesh_buffers::Load 262k triangles", 10, 0, [&]() { buffers = mesh_buffers::Load(path); return (float)buffers->GetTriangleCount(); });
+		if (!buffers) buffers = mesh_buffers::Load(path); //Filtered out above
+		bench(filter, "TriangleMesh build 262k triangles", 2, 0, [&]() { TriangleMesh mesh(buffers); return (float)mesh.GetTree().nodes.size(); });
+
+		{
+			TriangleMesh mesh(buffers);
+			Image viewport(16*20, 9*20, 255);
+			Camera cam(viewport, 75.0f*DEG2RAD);
+			bench(filter, "render 262k triangle mesh"            , 5, viewport.width * viewport.height, [&]() { return renderQuiet(cam, mesh); });
+			cam.usePackets = false;
+			bench(filter, "render 262k triangle mesh, no packets", 5, viewport.width * viewport.height, [&]() { return renderQuiet(cam, mesh); });
+		}
+
+		//Unmapped first, or Windows won't let it be deleted
+		buffers.reset();
+		std::remove(path.c_str());
+	}
+
+	{
+		//A million spheres saved both ways. Plain loads rebuild the tree; cached ones just map it.
+		std::mt19937 rng(6);
+		std::uniform_real_distribution<float> u(-200, 200);
+		Scene scene;
+		scene.reserve(1000000);
+		for (int i = 0; i < 1000000; i++) scene.add(Vector3(u(rng), u(rng), u(rng) + 400), 0.3f);
+		bench(filter, "Scene::rebuild 1M spheres", 1, 0, [&]() { scene.rebuild(); return (float)scene.GetTree().nodes.size(); });
+		if (scene.GetTree().IsEmpty()) scene.rebuild(); //Filtered out above
+
+		const std::string plainPath = "benchmark-plain.gps", cachedPath = "benchmark-cached.gps";
+		{
+			std::ofstream plain(plainPath, std::ios::binary);
+			scene.write_to(plain, scene_format::PLAIN);
+			std::ofstream cached(cachedPath, std::ios::binary);
+			scene.write_to(cached, scene_format::CACHED);
+		}
+
+		bench(filter, "Scene::Load 1M spheres, plain" , 1, 0, [&]() { return (float)Scene::Load(plainPath )->GetTree().nodes.size(); });
+		bench(filter, "Scene::Load 1M spheres, cached", 5, 0, [&]() { return (float)Scene::Load(cachedPath)->GetTree().nodes.size(); });
+		{
+			std::unique_ptr<Scene> loaded = Scene::Load(cachedPath);
+			Image viewport(loaded->settings.width, loaded->settings.height, loaded->settings.colorSpace);
+			Camera cam(viewport, loaded->settings.fov);
+			bench(filter, "render 1M spheres, cached Scene", 2, viewport.width * viewport.height, [&]() { return renderQuiet(cam, *loaded); });
+		}
+
+		std::remove(plainPath.c_str());
+		std::remove(cachedPath.c_str());
+	}
+
+	{
+		//Throughput against object count and distribution. Generating 10^7 spheres takes a while
+		//and a gigabyte or so, so those only run when asked for by name.
+		const char* const distributions[] = { "uniform", "clustered", "grid" };
+		for (int d = 0; d < 3; d++) {
+			int count = 1000;
+			for (int exponent = 3; exponent <= 7; exponent++, count *= 10) {
+				const std::string name = "render 10^" + std::to_string(exponent) + " spheres, " + distributions[d];
+				if (name.find(filter) == std::string::npos) continue;
+				if (exponent == 7 && filter.find("10^7") == std::string::npos) continue;
+
+				std::unique_ptr<Scene> scene = SceneGenerator((scene_distribution)d, count).generate();
+				Image viewport(scene->settings.width, scene->settings.height, scene->settings.colorSpace);
+				Camera cam(viewport, scene->settings.fov);
+				bench(filter, name, 2, viewport.width * viewport.height, [&]() { return renderQuiet(cam, *scene); });
+			}
+		}
+	}
+
+	#pragma endregion Render
+
+	return 0;
+}
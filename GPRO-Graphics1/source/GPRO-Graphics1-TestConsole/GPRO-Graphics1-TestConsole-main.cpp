@@ -29,41 +29,67 @@
 #include "camera.hpp"
 #include "image.hpp"
 #include "raytrace.hpp"
+#include "scene.hpp"
 
 #include "moremath.inl"
 
-#include <vector>
+#include <memory>
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 #include <string>
+#include <stdexcept>
+#include <system_error>
 
+//Usage: GPRO-Graphics1-TestConsole [scene.gps [cache.gps]]
+//With no scene file, renders the built-in test scene. Given a cache path too, the scene is
+//saved there preprocessed, tree and all, and loading that instead next time skips the build.
 int main(int const argc, char const* const argv[])
 {
+    std::cout << "Initializing test objects..." << std::endl;
+    std::unique_ptr<Scene> scene;
+    try {
+        if (argc > 1) scene = Scene::Load(argv[1]);
+        else {
+            scene.reset(new Scene());
+            scene->add(Vector3::forward(), 0.5f);
+            scene->rebuild();
+        }
+
+        if (argc > 2) {
+            //Opening the cache truncates it, and the scene may still be reading from argv[1]
+            std::error_code notFound;
+            if (std::filesystem::equivalent(argv[1], argv[2], notFound)) throw std::runtime_error("Can't cache a scene over its own file");
+
+            std::cout << "Caching scene..." << std::endl;
+            std::ofstream cache(argv[2], std::ios::binary);
+            if (!cache.is_open()) throw std::runtime_error(std::string("Couldn't open ") + argv[2]);
+            scene->write_to(cache, scene_format::CACHED);
+        }
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
     std::cout << "Initializing camera..." << std::endl;
 
-    Image viewport(16*20, 9*20, 255);
-    Camera cam(viewport, 75.0f*DEG2RAD);
-    
-    //Test objects. Anything passed to Camera::render must be allocated
-    //on heap to correctly render (polymorphism must take effect)
-    std::cout << "Initializing test objects..." << std::endl;
-    std::vector<Traceable*> objects;
-    objects.push_back(new Sphere(Vector3::forward(), 0.5f));
+    Image viewport(scene->settings.width, scene->settings.height, scene->settings.colorSpace);
+    Camera cam(viewport, scene->settings.fov);
 
     std::cout << "Raytracing..." << std::endl;
-    cam.render(objects);
+    cam.render(*scene);
 
     //Release objects
     std::cout << "Cleaning up test objects..." << std::endl;
-    for (int i = 0; i < objects.size(); i++) delete objects[i];
-    objects.clear();
+    scene.reset();
 
     //Write to (user-specified) file
     std::cout << "Enter output file: ";
     std::string tmp; getline(std::cin, tmp);
-    std::ofstream fout(tmp);
+    std::ofstream fout(tmp, std::ios::binary);
 
-    viewport.write_to(fout);
+    viewport.write_to(fout, image_format::P6);
     
     fout.flush();
     fout.close();